@@ -0,0 +1,102 @@
+// alloccount: with ALLOCCOUNT_INTERPOSE (the uninstalled benchmark binary
+// only), interposes the glibc allocator and forwards every entry point to its
+// __libc_* implementation, counting malloc/calloc/realloc calls while
+// enabled. free() and the aligned allocators are interposed too, so a
+// preloaded allocator (jemalloc, ASan) never frees glibc's memory. The
+// installed overlay builds the stubs and keeps the stock allocator.
+#include "alloccount.h"
+
+#include <stddef.h>
+
+#if defined(__GLIBC__) && defined(ALLOCCOUNT_INTERPOSE)
+
+#include <errno.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+extern void __libc_free(void *ptr);
+
+void *aligned_alloc(size_t alignment, size_t size);
+void *memalign(size_t alignment, size_t size);
+int posix_memalign(void **memptr, size_t alignment, size_t size);
+void *valloc(size_t size);
+void *pvalloc(size_t size);
+
+static bool counting;
+static uint64_t count;
+
+static inline void bump(void) {
+  if (__atomic_load_n(&counting, __ATOMIC_RELAXED)) {
+    __atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+  }
+}
+
+void *malloc(size_t size) {
+  bump();
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  bump();
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  bump();
+  return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+  __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size) {
+  bump();
+  return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  bump();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+  if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) return EINVAL;
+  bump();
+  void *p = __libc_memalign(alignment, size);
+  if (!p) return ENOMEM;
+  *memptr = p;
+  return 0;
+}
+
+void *valloc(size_t size) {
+  bump();
+  return __libc_valloc(size);
+}
+
+void *pvalloc(size_t size) {
+  bump();
+  return __libc_pvalloc(size);
+}
+
+bool alloccount_available(void) { return true; }
+
+void alloccount_enable(bool on) {
+  __atomic_store_n(&counting, on, __ATOMIC_RELAXED);
+}
+
+uint64_t alloccount_get(void) {
+  return __atomic_load_n(&count, __ATOMIC_RELAXED);
+}
+
+#else
+
+bool alloccount_available(void) { return false; }
+void alloccount_enable(bool on) { (void)on; }
+uint64_t alloccount_get(void) { return 0; }
+
+#endif
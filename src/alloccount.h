@@ -0,0 +1,19 @@
+// alloccount: process-wide heap allocation counter for --bench. Only the
+// x11-datetime-overlay-bench binary (built, not installed) counts; see
+// alloccount.c.
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// False when the allocator is not interposed (the installed binary, or a
+// non-glibc build).
+bool alloccount_available(void);
+
+// Counting is off by default; while on, every malloc/calloc/realloc made by
+// this process (including cairo, pixman and fontconfig) is counted.
+void alloccount_enable(bool on);
+uint64_t alloccount_get(void);
+
+#endif
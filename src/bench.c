@@ -0,0 +1,191 @@
+// bench: offscreen benchmark of the per-tick pipeline. See bench.h.
+#define _POSIX_C_SOURCE 200809L
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cairo/cairo.h>
+
+#include "alloccount.h"
+#include "flash.h"
+#include "render.h"
+#include "status.h"
+#include "timefmt.h"
+
+enum { STAGE_FORMAT, STAGE_COLOR, STAGE_MEASURE, STAGE_PAINT, STAGE_TOTAL, STAGE_COUNT };
+
+static const char *const stage_names[STAGE_COUNT] = {
+  [STAGE_FORMAT]  = "format",
+  [STAGE_COLOR]   = "color",
+  [STAGE_MEASURE] = "measure",
+  [STAGE_PAINT]   = "paint",
+  [STAGE_TOTAL]   = "total",
+};
+
+static int cmp_i64(const void *a, const void *b) {
+  int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static int64_t percentile(const int64_t *sorted, long n, double p) {
+  long i = (long)(p * (double)(n - 1) + 0.5);
+  return sorted[i];
+}
+
+int bench_run(const options_t *opt_in, long frames) {
+  if (frames <= 0) {
+    fprintf(stderr, "--bench needs a positive frame count\n");
+    return 2;
+  }
+
+  // Always exercise the fade; keep per-frame logging out of the numbers.
+  options_t opt = *opt_in;
+  if (opt.flash_minutes <= 0) opt.flash_minutes = 1;
+  opt.debug = false;
+  opt.atlas_cache = false;  // measure the real font load and rasterization
+
+  timefmt_t tf;
+  if (!timefmt_init(&tf, opt.format)) return 2;
+  status_t status;  // the flash count only: no sources, so runs stay comparable
+  status_init(&status);
+  char charset[ATLAS_CHARS_MAX];
+  timefmt_charset(&tf, charset, sizeof(charset));
+
+  render_t r;
+  if (!render_init(&r, &opt, charset)) {
+    fprintf(stderr, "Failed to load font \"%s\"\n", opt.font_family);
+    timefmt_destroy(&tf);
+    return 1;
+  }
+  cairo_surface_t *like = cairo_image_surface_create(CAIRO_FORMAT_RGB24, 1, 1);
+  bool have_atlas = render_atlas_init(&r, like);
+  cairo_surface_destroy(like);
+
+  flash_state_t flash;
+  flash_init(&flash);
+  fade_table_t fade;
+  fade_table_init(&fade, &opt);
+
+  int64_t *samples = calloc((size_t)frames * STAGE_COUNT, sizeof(*samples));
+  if (!samples) {
+    fprintf(stderr, "--bench: out of memory\n");
+    return 1;
+  }
+
+  // Simulated timeline: wall clock starts a few seconds before a flash
+  // boundary; the monotonic clock is the offset from the start. Each frame
+  // is the next event the real loop would wake for (a change of the format
+  // plan, a flash boundary or a fade step).
+  time_t start = time(NULL);
+  start = start - start % 60 + 60 - 3;
+  const int64_t wall0_ns = (int64_t)start * NS_PER_SEC;
+  int64_t sim_ns = 0;
+  int64_t next_tick = NS_PER_SEC;
+
+  cairo_surface_t *surface = NULL;
+  cairo_t *cr = NULL;
+  frame_t prev = {0}, cur = {0};
+  long flash_frames = 0;
+
+  alloccount_enable(true);
+  uint64_t allocs0 = alloccount_get();
+
+  for (long i = 0; i < frames; ++i) {
+    int64_t next_fade = flash_next_deadline(&flash, &fade, sim_ns);
+    sim_ns = (next_fade > 0 && next_fade < next_tick) ? next_fade : next_tick;
+    struct timespec wall = {
+      .tv_sec = (time_t)((wall0_ns + sim_ns) / NS_PER_SEC),
+      .tv_nsec = (long)((wall0_ns + sim_ns) % NS_PER_SEC)
+    };
+    time_t now = wall.tv_sec;
+
+    int64_t *s = &samples[(size_t)i * STAGE_COUNT];
+    int64_t t0 = mono_now_ns();
+
+    struct tm lt;
+    const char *nowstr = timefmt_update(&tf, &wall, flash.count, &lt);
+    uint64_t flashes = flash.count;
+    flash_update(&flash, &opt, &lt, now, sim_ns);
+    if (tf.has_flash && flash.count != flashes) nowstr = timefmt_update(&tf, &wall, flash.count, NULL);
+    // Same schedule as the main loop: the plan's next change, or the next
+    // flash boundary if that comes first (flashes are always on here).
+    struct timespec at;
+    time_t flash_at = flash_next_boundary(&opt, &lt, now);
+    if (!timefmt_next_change(&tf, &wall, &at) || flash_at < at.tv_sec) at = (struct timespec){ flash_at, 0 };
+    next_tick = (int64_t)at.tv_sec * NS_PER_SEC + at.tv_nsec - wall0_ns;
+    char dispbuf[FRAME_TEXT_MAX];
+    status_flash(&status, opt.show_flash_count ? flash.count : 0);
+    snprintf(dispbuf, sizeof(dispbuf), "%s", nowstr);
+    status_append(&status, dispbuf, sizeof(dispbuf));
+    int64_t t1 = mono_now_ns();
+
+    cur.colors = flash_colors(&flash, &fade, &opt, sim_ns, NULL);
+    if (flash.active) flash_frames++;
+    int64_t t2 = mono_now_ns();
+
+    render_layout(&r, dispbuf, &prev, &cur);
+    int64_t t3 = mono_now_ns();
+
+    // Back buffer stand-in, recreated on size change like the X path.
+    bool resized = false;
+    if (!surface || cairo_image_surface_get_width(surface) != cur.w ||
+        cairo_image_surface_get_height(surface) != cur.h) {
+      if (cr) cairo_destroy(cr);
+      if (surface) cairo_surface_destroy(surface);
+      surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, cur.w, cur.h);
+      cr = cairo_create(surface);
+      resized = true;
+    }
+    damage_t d;
+    if (render_damage(&r, &prev, &cur, resized, &d)) {
+      render_paint(&r, cr, &cur, &d);
+      cairo_surface_flush(surface);
+    }
+    int64_t t4 = mono_now_ns();
+
+    s[STAGE_FORMAT] = t1 - t0;
+    s[STAGE_COLOR] = t2 - t1;
+    s[STAGE_MEASURE] = t3 - t2;
+    s[STAGE_PAINT] = t4 - t3;
+    s[STAGE_TOTAL] = t4 - t0;
+    prev = cur;
+  }
+
+  uint64_t allocs = alloccount_get() - allocs0;
+  alloccount_enable(false);
+
+  printf("bench: %ld frames (%ld during flash fades), %ux%u px, atlas=%s, font=\"%s\" %.1fpx\n",
+         frames, flash_frames, cur.w, cur.h, have_atlas ? "yes" : "no",
+         opt.font_family, opt.font_size_px);
+  printf("%-8s %10s %10s %10s %10s %10s\n", "stage", "p50 ns", "p90 ns", "p99 ns", "max ns", "mean ns");
+  int64_t *col = malloc((size_t)frames * sizeof(*col));
+  if (col) {
+    for (int st = 0; st < STAGE_COUNT; ++st) {
+      double sum = 0.0;
+      for (long i = 0; i < frames; ++i) {
+        col[i] = samples[(size_t)i * STAGE_COUNT + st];
+        sum += (double)col[i];
+      }
+      qsort(col, (size_t)frames, sizeof(*col), cmp_i64);
+      printf("%-8s %10lld %10lld %10lld %10lld %10.0f\n", stage_names[st],
+             (long long)percentile(col, frames, 0.50), (long long)percentile(col, frames, 0.90),
+             (long long)percentile(col, frames, 0.99), (long long)col[frames - 1],
+             sum / (double)frames);
+    }
+    free(col);
+  }
+  if (alloccount_available()) {
+    printf("allocations: %llu total, %.3f/frame\n", (unsigned long long)allocs,
+           (double)allocs / (double)frames);
+  } else {
+    printf("allocations: not counted (only x11-datetime-overlay-bench counts them)\n");
+  }
+
+  free(samples);
+  if (cr) cairo_destroy(cr);
+  if (surface) cairo_surface_destroy(surface);
+  timefmt_destroy(&tf);
+  render_destroy(&r);
+  return 0;
+}
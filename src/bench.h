@@ -0,0 +1,13 @@
+// bench: offscreen benchmark of the per-tick pipeline (--bench N).
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "overlay.h"
+
+// Runs `frames` ticks of format, flash/color, measure and paint against a
+// cairo image surface, with no X connection, over a simulated timeline that
+// includes flash fades. Prints per-stage ns/frame percentiles and heap
+// allocations per frame to stdout. Returns a process exit code.
+int bench_run(const options_t *opt, long frames);
+
+#endif
@@ -0,0 +1,275 @@
+// bitmap: the built-in 5x7 bitmap font. See bitmap.h.
+#define _POSIX_C_SOURCE 200809L
+#include "bitmap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Printable ASCII, one byte per row, bit 4 is the leftmost column.
+static const uint8_t font5x7[95][BITMAP_GLYPH_H] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+  { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 }, // '!'
+  { 0x0a, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00 }, // '"'
+  { 0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a }, // '#'
+  { 0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04 }, // '$'
+  { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // '%'
+  { 0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d }, // '&'
+  { 0x0c, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 }, // '\''
+  { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // '('
+  { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // ')'
+  { 0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00 }, // '*'
+  { 0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00 }, // '+'
+  { 0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08 }, // ','
+  { 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 }, // '-'
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c }, // '.'
+  { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // '/'
+  { 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e }, // '0'
+  { 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e }, // '1'
+  { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f }, // '2'
+  { 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e }, // '3'
+  { 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 }, // '4'
+  { 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e }, // '5'
+  { 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e }, // '6'
+  { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // '7'
+  { 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e }, // '8'
+  { 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c }, // '9'
+  { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 }, // ':'
+  { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08 }, // ';'
+  { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, // '<'
+  { 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00 }, // '='
+  { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, // '>'
+  { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, // '?'
+  { 0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e }, // '@'
+  { 0x0e, 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11 }, // 'A'
+  { 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e }, // 'B'
+  { 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e }, // 'C'
+  { 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c }, // 'D'
+  { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f }, // 'E'
+  { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 }, // 'F'
+  { 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f }, // 'G'
+  { 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 }, // 'H'
+  { 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e }, // 'I'
+  { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c }, // 'J'
+  { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // 'K'
+  { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f }, // 'L'
+  { 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 }, // 'M'
+  { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // 'N'
+  { 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, // 'O'
+  { 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 }, // 'P'
+  { 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d }, // 'Q'
+  { 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 }, // 'R'
+  { 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e }, // 'S'
+  { 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // 'T'
+  { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, // 'U'
+  { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 }, // 'V'
+  { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a }, // 'W'
+  { 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 }, // 'X'
+  { 0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04 }, // 'Y'
+  { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f }, // 'Z'
+  { 0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e }, // '['
+  { 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 }, // '\\'
+  { 0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e }, // ']'
+  { 0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00 }, // '^'
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f }, // '_'
+  { 0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00 }, // '`'
+  { 0x00, 0x00, 0x0e, 0x01, 0x0f, 0x11, 0x0f }, // 'a'
+  { 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1e }, // 'b'
+  { 0x00, 0x00, 0x0e, 0x10, 0x10, 0x11, 0x0e }, // 'c'
+  { 0x01, 0x01, 0x0d, 0x13, 0x11, 0x11, 0x0f }, // 'd'
+  { 0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e }, // 'e'
+  { 0x06, 0x09, 0x08, 0x1c, 0x08, 0x08, 0x08 }, // 'f'
+  { 0x00, 0x0f, 0x11, 0x11, 0x0f, 0x01, 0x0e }, // 'g'
+  { 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11 }, // 'h'
+  { 0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x0e }, // 'i'
+  { 0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0c }, // 'j'
+  { 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12 }, // 'k'
+  { 0x0c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e }, // 'l'
+  { 0x00, 0x00, 0x1a, 0x15, 0x15, 0x11, 0x11 }, // 'm'
+  { 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 }, // 'n'
+  { 0x00, 0x00, 0x0e, 0x11, 0x11, 0x11, 0x0e }, // 'o'
+  { 0x00, 0x00, 0x1e, 0x11, 0x1e, 0x10, 0x10 }, // 'p'
+  { 0x00, 0x00, 0x0d, 0x13, 0x0f, 0x01, 0x01 }, // 'q'
+  { 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10 }, // 'r'
+  { 0x00, 0x00, 0x0e, 0x10, 0x0e, 0x01, 0x1e }, // 's'
+  { 0x08, 0x08, 0x1c, 0x08, 0x08, 0x09, 0x06 }, // 't'
+  { 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0d }, // 'u'
+  { 0x00, 0x00, 0x11, 0x11, 0x11, 0x0a, 0x04 }, // 'v'
+  { 0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0a }, // 'w'
+  { 0x00, 0x00, 0x11, 0x0a, 0x04, 0x0a, 0x11 }, // 'x'
+  { 0x00, 0x00, 0x11, 0x11, 0x0f, 0x01, 0x0e }, // 'y'
+  { 0x00, 0x00, 0x1f, 0x02, 0x04, 0x08, 0x1f }, // 'z'
+  { 0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02 }, // '{'
+  { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // '|'
+  { 0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08 }, // '}'
+  { 0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00 }, // '~'
+};
+
+static const uint8_t *glyph_of(char ch) {
+  unsigned char u = (unsigned char)ch;
+  if (u < 0x20 || u > 0x7e) u = '?';
+  return font5x7[u - 0x20];
+}
+
+static int mask_shift(uint32_t mask) {
+  int s = 0;
+  while (mask && !(mask & 1)) {
+    mask >>= 1;
+    ++s;
+  }
+  return s;
+}
+
+static int mask_bits(uint32_t mask) {
+  int n = 0;
+  for (; mask; mask >>= 1) n += (int)(mask & 1);
+  return n;
+}
+
+// Scaled to the mask's own width: 5 or 6 bits at 16 bpp, 8 at depth 24, 10
+// on depth-30 visuals.
+static uint32_t channel(double v, uint32_t mask) {
+  int bits = mask_bits(mask);
+  uint32_t c = (uint32_t)(v * (double)((1ull << bits) - 1) + 0.5);
+  return (c << mask_shift(mask)) & mask;
+}
+
+static uint32_t pixel_of(const bitmap_t *b, double r, double g, double bl) {
+  uint32_t p = channel(r, b->red_mask) | channel(g, b->green_mask) | channel(bl, b->blue_mask);
+  // A 32-bit visual has alpha in the remaining bits; keep it opaque.
+  if (b->depth == 32) p |= ~(b->red_mask | b->green_mask | b->blue_mask);
+  return p;
+}
+
+static void put_pixel(const bitmap_t *b, uint8_t *p, uint32_t v) {
+  for (int i = 0; i < b->bytes_pp; ++i) {
+    int shift = 8 * (b->lsb_first ? i : b->bytes_pp - 1 - i);
+    p[i] = (uint8_t)(v >> shift);
+  }
+}
+
+bool bitmap_init(bitmap_t *b, const options_t *opt, xcb_connection_t *c, const xcb_screen_t *screen,
+                 const xcb_visualtype_t *visual) {
+  memset(b, 0, sizeof(*b));
+  const xcb_setup_t *setup = xcb_get_setup(c);
+  const xcb_format_t *fmt = NULL;
+  xcb_format_iterator_t it = xcb_setup_pixmap_formats_iterator(setup);
+  for (; it.rem; xcb_format_next(&it)) {
+    if (it.data->depth == screen->root_depth) fmt = it.data;
+  }
+  if (!visual || visual->_class != XCB_VISUAL_CLASS_TRUE_COLOR || !fmt ||
+      (fmt->bits_per_pixel != 16 && fmt->bits_per_pixel != 32)) {
+    fprintf(stderr, "--backend bitmap needs a 16 or 32 bpp TrueColor visual\n");
+    return false;
+  }
+  b->depth = screen->root_depth;
+  b->bytes_pp = (uint8_t)(fmt->bits_per_pixel / 8);
+  b->scanline_pad = fmt->scanline_pad;
+  b->lsb_first = setup->image_byte_order == XCB_IMAGE_ORDER_LSB_FIRST;
+  b->red_mask = visual->red_mask;
+  b->green_mask = visual->green_mask;
+  b->blue_mask = visual->blue_mask;
+  // Request length is in 4-byte units; PutImage has a 24-byte header.
+  b->max_put_bytes = (size_t)xcb_get_maximum_request_length(c) * 4 - 24;
+
+  b->scale = (int)(opt->font_size_px / BITMAP_CELL_H + 0.5);
+  if (b->scale < 1) b->scale = 1;
+  b->cell_w = BITMAP_CELL_W * b->scale;
+  b->cell_h = BITMAP_CELL_H * b->scale;
+  b->pad = opt->margin_px;
+  return true;
+}
+
+void bitmap_destroy(bitmap_t *b) {
+  free(b->pixels);
+  b->pixels = NULL;
+  b->cap = 0;
+}
+
+void bitmap_layout(const bitmap_t *b, const char *s, frame_t *f) {
+  if (f->str != s) {
+    strncpy(f->str, s, sizeof(f->str) - 1);
+    f->str[sizeof(f->str) - 1] = '\0';
+  }
+  size_t n = strlen(f->str);
+  f->use_atlas = true;  // fixed cells: partial repaints are exact
+  f->x_advance = (double)n * b->cell_w;
+  f->x_bearing = 0.0;
+  f->w = (uint16_t)(n * (size_t)b->cell_w + b->pad * 2);
+  f->h = (uint16_t)(b->cell_h + (int)b->pad * 2);
+  f->text_x = b->pad;
+  f->text_y = b->pad;
+}
+
+bool bitmap_damage(const bitmap_t *b, const frame_t *prev, const frame_t *f, bool force_full, damage_t *d) {
+  size_t n = strlen(f->str);
+  d->full = force_full || f->w != prev->w || f->h != prev->h || n != strlen(prev->str) ||
+            memcmp(&f->colors, &prev->colors, sizeof(f->colors)) != 0;
+  d->x0 = 0;
+  d->x1 = f->w;
+  if (d->full) return true;
+
+  size_t first = 0;
+  while (first < n && prev->str[first] == f->str[first]) ++first;
+  if (first == n) return false;
+  size_t last = n - 1;
+  while (last > first && prev->str[last] == f->str[last]) --last;
+  d->x0 = (int)b->pad + (int)first * b->cell_w;
+  d->x1 = (int)b->pad + (int)(last + 1) * b->cell_w;
+  return true;
+}
+
+bool bitmap_paint(bitmap_t *b, xcb_connection_t *c, xcb_drawable_t dst, xcb_gcontext_t gc,
+                  const frame_t *f, const damage_t *d) {
+  if (d->x1 <= d->x0) return true;
+  int sw = d->x1 - d->x0;
+  size_t pad_bytes = b->scanline_pad / 8;
+  size_t stride = ((size_t)sw * b->bytes_pp + pad_bytes - 1) / pad_bytes * pad_bytes;
+  size_t need = stride * f->h;
+  if (need > b->cap) {
+    uint8_t *p = realloc(b->pixels, need);
+    if (!p) return false;
+    b->pixels = p;
+    b->cap = need;
+  }
+
+  // Background, then the set font pixels of every cell in the span, each
+  // as a scale x scale block.
+  const colors_t *col = &f->colors;
+  uint32_t bg = pixel_of(b, col->bg_r, col->bg_g, col->bg_b);
+  uint32_t fg = pixel_of(b, col->fg_r, col->fg_g, col->fg_b);
+  for (int y = 0; y < f->h; ++y) {
+    uint8_t *row = b->pixels + (size_t)y * stride;
+    for (int x = 0; x < sw; ++x) put_pixel(b, row + (size_t)x * b->bytes_pp, bg);
+  }
+  int s = b->scale;
+  for (size_t i = 0; f->str[i]; ++i) {
+    int cell_x = (int)f->text_x + (int)i * b->cell_w;
+    if (cell_x >= d->x1 || cell_x + b->cell_w <= d->x0) continue;
+    const uint8_t *g = glyph_of(f->str[i]);
+    for (int gy = 0; gy < BITMAP_GLYPH_H; ++gy) {
+      for (int gx = 0; gx < BITMAP_GLYPH_W; ++gx) {
+        if (!(g[gy] & (0x10 >> gx))) continue;
+        int px = cell_x + gx * s - d->x0;
+        int py = (int)f->text_y + (gy + 1) * s;
+        for (int y = py; y < py + s; ++y) {
+          uint8_t *row = b->pixels + (size_t)y * stride;
+          for (int x = px; x < px + s; ++x) {
+            if (x >= 0 && x < sw) put_pixel(b, row + (size_t)x * b->bytes_pp, fg);
+          }
+        }
+      }
+    }
+  }
+
+  // Upload in bands of rows that fit one request.
+  int band = stride ? (int)(b->max_put_bytes / stride) : f->h;
+  if (band < 1) band = 1;
+  for (int y = 0; y < f->h; y += band) {
+    int rows = f->h - y < band ? f->h - y : band;
+    xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, dst, gc, (uint16_t)sw, (uint16_t)rows,
+                  (int16_t)d->x0, (int16_t)y, 0, b->depth, (uint32_t)(stride * (size_t)rows),
+                  b->pixels + (size_t)y * stride);
+  }
+  return true;
+}
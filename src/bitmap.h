@@ -0,0 +1,55 @@
+// bitmap: the built-in 5x7 bitmap font, for --backend bitmap. No Cairo,
+// fontconfig or FreeType: glyphs are scaled by an integer factor from
+// --size, drawn into a small client buffer in the screen's pixel format and
+// uploaded with PutImage. Startup touches no font files at all.
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <xcb/xcb.h>
+
+#include "frame.h"
+#include "overlay.h"
+
+#define BITMAP_GLYPH_W 5
+#define BITMAP_GLYPH_H 7
+#define BITMAP_CELL_W 6    // one column of spacing
+#define BITMAP_CELL_H 9    // one row above and below
+
+typedef struct {
+  int scale;                  // screen pixels per font pixel
+  int cell_w, cell_h;         // scaled cell
+  uint32_t pad;               // margin around the text inside the window
+  uint8_t depth;
+  uint8_t bytes_pp;           // 2 or 4
+  uint8_t scanline_pad;       // bits
+  bool lsb_first;             // image byte order
+  uint32_t red_mask, green_mask, blue_mask;
+  size_t max_put_bytes;       // largest PutImage payload the server accepts
+  uint8_t *pixels;            // scratch image of the damaged span
+  size_t cap;
+} bitmap_t;
+
+// Checks that the screen has a 16 or 32 bits per pixel TrueColor visual the
+// font can be drawn in, and derives the scale from opt->font_size_px.
+// Prints the reason and returns false otherwise.
+bool bitmap_init(bitmap_t *b, const options_t *opt, xcb_connection_t *c, const xcb_screen_t *screen,
+                 const xcb_visualtype_t *visual);
+void bitmap_destroy(bitmap_t *b);
+
+// Lays out s into f: every character is one fixed cell, so the size depends
+// only on the length. Colors are left to the caller.
+void bitmap_layout(const bitmap_t *b, const char *s, frame_t *f);
+
+// Damage between prev and f, with the same rules as render_damage.
+bool bitmap_damage(const bitmap_t *b, const frame_t *prev, const frame_t *f, bool force_full, damage_t *d);
+
+// Draws the damaged span of f and uploads it to dst at the same position.
+// Returns false if the scratch buffer could not be grown.
+bool bitmap_paint(bitmap_t *b, xcb_connection_t *c, xcb_drawable_t dst, xcb_gcontext_t gc,
+                  const frame_t *f, const damage_t *d);
+
+#endif
@@ -0,0 +1,105 @@
+// cachefile: mapped, atomically replaced cache files. See cachefile.h.
+#define _POSIX_C_SOURCE 200809L
+#include "cachefile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_SUBDIR "x11-datetime-overlay"
+
+static bool cache_dir(char *out, size_t size) {
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  int n;
+  if (xdg && xdg[0] == '/') n = snprintf(out, size, "%s/" CACHE_SUBDIR, xdg);
+  else if (home && home[0]) n = snprintf(out, size, "%s/.cache/" CACHE_SUBDIR, home);
+  else return false;
+  return n > 0 && (size_t)n < size;
+}
+
+// mkdir -p for the components of dir.
+static bool make_dirs(char *dir) {
+  for (char *p = dir + 1; *p; ++p) {
+    if (*p != '/') continue;
+    *p = '\0';
+    bool ok = mkdir(dir, 0700) == 0 || errno == EEXIST;
+    *p = '/';
+    if (!ok) return false;
+  }
+  return mkdir(dir, 0700) == 0 || errno == EEXIST;
+}
+
+bool cachefile_path(const char *name, char *out, size_t size) {
+  char dir[512];
+  if (!cache_dir(dir, sizeof(dir))) return false;
+  int n = snprintf(out, size, "%s/%s", dir, name);
+  return n > 0 && (size_t)n < size;
+}
+
+bool cachefile_map(const char *path, cachefile_map_t *m) {
+  m->addr = NULL;
+  m->size = 0;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 || sb.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+  void *addr = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) return false;
+  m->addr = addr;
+  m->size = (size_t)sb.st_size;
+  return true;
+}
+
+void cachefile_unmap(cachefile_map_t *m) {
+  if (m->addr) munmap(m->addr, m->size);
+  m->addr = NULL;
+  m->size = 0;
+}
+
+bool cachefile_write(const char *path, const void *const parts[], const size_t sizes[], size_t n) {
+  char dir[512], tmp[600];
+  if (!cache_dir(dir, sizeof(dir)) || !make_dirs(dir)) return false;
+  int len = snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+  if (len <= 0 || (size_t)len >= sizeof(tmp)) return false;
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) return false;
+  bool ok = true;
+  for (size_t i = 0; ok && i < n; ++i) {
+    const char *p = parts[i];
+    size_t left = sizes[i];
+    while (left) {
+      ssize_t w = write(fd, p, left);
+      if (w < 0 && errno == EINTR) continue;
+      if (w <= 0) {
+        ok = false;
+        break;
+      }
+      p += w;
+      left -= (size_t)w;
+    }
+  }
+  ok = close(fd) == 0 && ok;
+  if (ok) ok = rename(tmp, path) == 0;
+  if (!ok) unlink(tmp);
+  return ok;
+}
+
+unsigned long long cachefile_hash(const char *s) {
+  unsigned long long h = 1469598103934665603ULL;
+  for (; *s; ++s) {
+    h ^= (unsigned char)*s;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
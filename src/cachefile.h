@@ -0,0 +1,31 @@
+// cachefile: small binary files under $XDG_CACHE_HOME/x11-datetime-overlay
+// (~/.cache/... without it). Files are read through a read-only mapping and
+// replaced atomically (written aside, then renamed), so concurrent
+// instances never see a partial file.
+#ifndef CACHEFILE_H
+#define CACHEFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+  void *addr;   // NULL when nothing is mapped
+  size_t size;
+} cachefile_map_t;
+
+// Writes the path of cache file name to out. Returns false if neither
+// $XDG_CACHE_HOME nor $HOME is set or the path does not fit.
+bool cachefile_path(const char *name, char *out, size_t size);
+
+// Maps path read-only. Returns false if it is missing, empty or unreadable.
+bool cachefile_map(const char *path, cachefile_map_t *m);
+void cachefile_unmap(cachefile_map_t *m);
+
+// Replaces path with the concatenation of the n parts, creating the cache
+// directory if needed. Returns false (leaving any old file) on failure.
+bool cachefile_write(const char *path, const void *const parts[], const size_t sizes[], size_t n);
+
+// 64-bit FNV-1a of s, for naming files after their key.
+unsigned long long cachefile_hash(const char *s);
+
+#endif
@@ -0,0 +1,142 @@
+// control: line commands over a UNIX socket. See control.h.
+#define _POSIX_C_SOURCE 200809L
+#include "control.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool set_nonblock_cloexec(int fd) {
+  int fl = fcntl(fd, F_GETFL);
+  return fl >= 0 && fcntl(fd, F_SETFL, fl | O_NONBLOCK) == 0 && fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+static struct sockaddr_un control_addr(const char *path) {
+  struct sockaddr_un sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  memcpy(sa.sun_path, path, strlen(path) + 1);
+  return sa;
+}
+
+// A socket file nobody listens on any more (the previous instance died).
+static bool control_stale(const char *path) {
+  struct stat sb;
+  if (lstat(path, &sb) != 0 || !S_ISSOCK(sb.st_mode)) return false;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  struct sockaddr_un sa = control_addr(path);
+  bool stale = connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 && errno == ECONNREFUSED;
+  close(fd);
+  return stale;
+}
+
+bool control_open(control_t *c, const char *path) {
+  memset(c, 0, sizeof(*c));
+  c->fd = -1;
+  for (int i = 0; i < CONTROL_CLIENTS_MAX; ++i) c->clients[i].fd = -1;
+  if (strlen(path) >= sizeof(c->path)) {
+    fprintf(stderr, "Control socket path too long: %s\n", path);
+    return false;
+  }
+  memcpy(c->path, path, strlen(path) + 1);
+  if (control_stale(path)) unlink(path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un sa = control_addr(path);
+  if (fd < 0 || !set_nonblock_cloexec(fd) || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+      listen(fd, CONTROL_CLIENTS_MAX) < 0) {
+    perror(path);
+    if (fd >= 0) close(fd);
+    c->path[0] = '\0';  // not ours to unlink
+    return false;
+  }
+  c->fd = fd;
+  return true;
+}
+
+void control_close(control_t *c) {
+  if (c->fd < 0) return;
+  for (int i = 0; i < CONTROL_CLIENTS_MAX; ++i) control_drop(c, i);
+  close(c->fd);
+  unlink(c->path);
+  c->fd = -1;
+}
+
+int control_fd(const control_t *c) {
+  return c->fd;
+}
+
+int control_accept(control_t *c) {
+  int fd = accept(c->fd, NULL, NULL);
+  if (fd < 0) return -1;
+  for (int i = 0; i < CONTROL_CLIENTS_MAX; ++i) {
+    control_client_t *cl = &c->clients[i];
+    if (cl->fd >= 0) continue;
+    if (!set_nonblock_cloexec(fd)) break;
+    memset(cl, 0, sizeof(*cl));
+    cl->fd = fd;
+    return i;
+  }
+  close(fd);
+  return -1;
+}
+
+int control_client_fd(const control_t *c, int i) {
+  return c->clients[i].fd;
+}
+
+bool control_read(control_t *c, int i) {
+  control_client_t *cl = &c->clients[i];
+  if (cl->len == CONTROL_LINE_MAX) {
+    // Full: fine while lines are waiting to be taken, otherwise too long.
+    return memchr(cl->buf + cl->off, '\n', cl->len - cl->off) != NULL;
+  }
+  ssize_t n = read(cl->fd, cl->buf + cl->len, CONTROL_LINE_MAX - cl->len);
+  if (n > 0) {
+    cl->len += (size_t)n;
+    return true;
+  }
+  if (n < 0 && (errno == EAGAIN || errno == EINTR)) return true;
+  cl->eof = true;
+  return false;
+}
+
+char *control_line(control_t *c, int i) {
+  control_client_t *cl = &c->clients[i];
+  char *start = cl->buf + cl->off;
+  char *nl = memchr(start, '\n', cl->len - cl->off);
+  if (!nl) {
+    if (cl->eof && cl->len > cl->off && cl->len < CONTROL_LINE_MAX) {
+      cl->buf[cl->len] = '\0';
+      cl->off = cl->len;
+      return start;
+    }
+    memmove(cl->buf, start, cl->len - cl->off);
+    cl->len -= cl->off;
+    cl->off = 0;
+    return NULL;
+  }
+  *nl = '\0';
+  if (nl > start && nl[-1] == '\r') nl[-1] = '\0';
+  cl->off = (size_t)(nl + 1 - cl->buf);
+  return start;
+}
+
+void control_reply(control_t *c, int i, const char *text) {
+  control_client_t *cl = &c->clients[i];
+  if (cl->fd < 0) return;
+  ssize_t n = send(cl->fd, text, strlen(text), MSG_DONTWAIT | MSG_NOSIGNAL);
+  (void)n;
+}
+
+void control_drop(control_t *c, int i) {
+  control_client_t *cl = &c->clients[i];
+  if (cl->fd >= 0) close(cl->fd);
+  cl->fd = -1;
+}
@@ -0,0 +1,62 @@
+// control: a UNIX stream socket (--control PATH) taking line commands, so a
+// running overlay can be reconfigured without a restart:
+//
+//   set KEY VALUE   change a setting (see settings.h), e.g. "set bg #101010"
+//   reload          re-read the --config file
+//   show            print the current settings
+//
+// Lines that arrive together are applied as one change, so a palette switch
+// (fg and bg) is a single repaint. Every line gets an "ok" or "error: ..."
+// reply. Clients are served from the event loop and never block it.
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CONTROL_CLIENTS_MAX 4
+#define CONTROL_LINE_MAX 512
+
+typedef struct {
+  int fd;      // -1 when the slot is free
+  bool eof;    // the client closed its side; the rest is the last line
+  size_t len;  // buffered bytes
+  size_t off;  // start of the next line
+  char buf[CONTROL_LINE_MAX];
+} control_client_t;
+
+typedef struct {
+  char path[108];  // sun_path
+  int fd;          // listening socket, -1 if none
+  control_client_t clients[CONTROL_CLIENTS_MAX];
+} control_t;
+
+// Listens on path, replacing a stale socket left by a dead instance. Prints
+// the problem and returns false if path is in use or cannot be bound.
+bool control_open(control_t *c, const char *path);
+void control_close(control_t *c);
+
+int control_fd(const control_t *c);
+
+// Accepts a pending connection. Returns its client slot, or -1 (the
+// connection is refused when every slot is busy).
+int control_accept(control_t *c);
+
+int control_client_fd(const control_t *c, int i);
+
+// Reads what client i sent. Returns false if it is gone (or sent a line
+// longer than CONTROL_LINE_MAX); it should then be dropped once its
+// buffered lines are handled.
+bool control_read(control_t *c, int i);
+
+// Next complete line of client i (NUL-terminated, without the newline), or
+// NULL when none is buffered.
+char *control_line(control_t *c, int i);
+
+// Queues text for client i without blocking; a client that does not read
+// its replies loses them.
+void control_reply(control_t *c, int i, const char *text);
+
+void control_drop(control_t *c, int i);
+
+#endif
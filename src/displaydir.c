@@ -0,0 +1,75 @@
+// displaydir: X sockets in a directory. See displaydir.h.
+#define _POSIX_C_SOURCE 200809L
+#include "displaydir.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Display number of an X<n> socket name, -1 for anything else.
+static long socket_display(const char *name) {
+  if (name[0] != 'X' || !name[1]) return -1;
+  long n = 0;
+  for (const char *p = name + 1; *p; ++p) {
+    if (!isdigit((unsigned char)*p) || n > 999999) return -1;
+    n = n * 10 + (*p - '0');
+  }
+  return n;
+}
+
+bool displaydir_init(displaydir_t *d, const char *path) {
+  d->path = path;
+  d->fd = -1;
+  DIR *dir = opendir(path);
+  if (!dir) {
+    perror(path);
+    return false;
+  }
+  closedir(dir);
+  d->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (d->fd >= 0 && inotify_add_watch(d->fd, path, IN_CREATE | IN_MOVED_TO) < 0) {
+    close(d->fd);
+    d->fd = -1;
+  }
+  if (d->fd < 0) fprintf(stderr, "Cannot watch %s; only displays present now are shown\n", path);
+  return true;
+}
+
+void displaydir_destroy(displaydir_t *d) {
+  if (d->fd >= 0) close(d->fd);
+  d->fd = -1;
+}
+
+size_t displaydir_scan(const displaydir_t *d, char names[][DISPLAY_NAME_MAX], size_t max) {
+  DIR *dir = opendir(d->path);
+  if (!dir) return 0;
+  size_t n = 0;
+  struct dirent *de;
+  while (n < max && (de = readdir(dir)) != NULL) {
+    long num = socket_display(de->d_name);
+    if (num >= 0) snprintf(names[n++], DISPLAY_NAME_MAX, ":%ld", num);
+  }
+  closedir(dir);
+  return n;
+}
+
+int displaydir_fd(const displaydir_t *d) {
+  return d->fd;
+}
+
+bool displaydir_handle(displaydir_t *d) {
+  char evbuf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool appeared = false;
+  ssize_t n;
+  while ((n = read(d->fd, evbuf, sizeof(evbuf))) > 0) {
+    for (char *p = evbuf; p < evbuf + n; ) {
+      const struct inotify_event *ie = (const struct inotify_event *)p;
+      if (ie->len > 0 && socket_display(ie->name) >= 0) appeared = true;
+      p += sizeof(struct inotify_event) + ie->len;
+    }
+  }
+  return appeared;
+}
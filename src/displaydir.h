@@ -0,0 +1,31 @@
+// displaydir: X servers found in a socket directory (usually /tmp/.X11-unix),
+// for --display-dir. A socket named X<n> is display ":<n>"; an inotify
+// watch reports new ones as sessions (Xvfb, Xpra, seats) start.
+#ifndef DISPLAYDIR_H
+#define DISPLAYDIR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define DISPLAY_NAME_MAX 64
+
+typedef struct {
+  const char *path;
+  int fd;   // inotify fd, -1 if new sockets cannot be watched
+} displaydir_t;
+
+// Opens path for scanning and watches it for new sockets. Prints the
+// problem and returns false if it is not a readable directory.
+bool displaydir_init(displaydir_t *d, const char *path);
+void displaydir_destroy(displaydir_t *d);
+
+// Writes the display name of every X<n> socket in the directory to names
+// (at most max). Returns the count.
+size_t displaydir_scan(const displaydir_t *d, char names[][DISPLAY_NAME_MAX], size_t max);
+
+int displaydir_fd(const displaydir_t *d);
+
+// Drains the watch. Returns true if a socket appeared (time to rescan).
+bool displaydir_handle(displaydir_t *d);
+
+#endif
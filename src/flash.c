@@ -0,0 +1,115 @@
+// flash: boundary-aligned flash trigger and its precomputed color fade.
+#define _POSIX_C_SOURCE 200809L
+#include "flash.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void flash_init(flash_state_t *f) {
+  f->active = false;
+  f->start_ns = 0;
+  f->last_boundary_min_epoch = -1;
+  f->count = 0;
+}
+
+void fade_table_init(fade_table_t *t, const options_t *opt) {
+  const double bg[3] = { opt->bg_r, opt->bg_g, opt->bg_b };
+  long from[3], to[3], span = 0;
+  for (int c = 0; c < 3; ++c) {
+    to[c] = lround(bg[c] * 255.0);
+    from[c] = 255 - to[c];
+    long d = labs(to[c] - from[c]);
+    if (d > span) span = d;
+  }
+  long n = span / FADE_MIN_DELTA;
+  if (n < 1) n = 1;
+  if (n > FADE_MAX_STEPS) n = FADE_MAX_STEPS;
+
+  const int64_t dur_ns = (int64_t)FLASH_DURATION_SEC * NS_PER_SEC;
+  t->n = (size_t)n;
+  for (long k = 0; k < n; ++k) {
+    fade_step_t *st = &t->steps[k];
+    st->at_ns = (dur_ns * k + n - 1) / n;  // rounded up so fade_step_at(at_ns) == k
+    double q[3];
+    for (int c = 0; c < 3; ++c) {
+      q[c] = (double)lround((double)from[c] + (double)(to[c] - from[c]) * (double)k / (double)n) / 255.0;
+    }
+    st->colors.bg_r = q[0]; st->colors.bg_g = q[1]; st->colors.bg_b = q[2];
+    st->colors.fg_r = 1.0 - q[0]; st->colors.fg_g = 1.0 - q[1]; st->colors.fg_b = 1.0 - q[2];
+  }
+}
+
+size_t fade_step_at(const fade_table_t *t, int64_t elapsed_ns) {
+  if (elapsed_ns <= 0) return 0;
+  const int64_t dur_ns = (int64_t)FLASH_DURATION_SEC * NS_PER_SEC;
+  size_t k = (size_t)((elapsed_ns * (int64_t)t->n) / dur_ns);
+  return k < t->n ? k : t->n - 1;
+}
+
+bool flash_update(flash_state_t *f, const options_t *opt, const struct tm *lt, time_t now, int64_t now_ns) {
+  if (opt->flash_minutes <= 0) return false;
+
+  // Boundary-aligned flash trigger: minute % flash_minutes == 0 at sec 00
+  long epoch_min = (long)(now / 60);
+  if (!f->active && lt->tm_sec == 0 && (lt->tm_min % opt->flash_minutes) == 0) {
+    if (f->last_boundary_min_epoch != epoch_min) {
+      f->active = true;
+      f->start_ns = now_ns;
+      f->last_boundary_min_epoch = epoch_min;
+      f->count++;
+      if (opt->debug) {
+        fprintf(stderr, "[debug] flash start: epoch_min=%ld (time %02d:%02d) count=%llu\n",
+                epoch_min, lt->tm_hour, lt->tm_min, (unsigned long long)f->count);
+      }
+      return true;
+    }
+  }
+  if (f->active && now_ns - f->start_ns >= (int64_t)FLASH_DURATION_SEC * NS_PER_SEC) {
+    f->active = false;
+    if (opt->debug) fprintf(stderr, "[debug] flash end (count=%llu)\n", (unsigned long long)f->count);
+    return true;
+  }
+  return false;
+}
+
+time_t flash_next_boundary(const options_t *opt, const struct tm *lt, time_t now) {
+  if (opt->flash_minutes <= 0) return 0;
+  time_t minute_start = now - lt->tm_sec;
+  int to_flash = opt->flash_minutes - lt->tm_min % opt->flash_minutes;
+  int to_hour = 60 - lt->tm_min;
+  return minute_start + (time_t)(to_flash < to_hour ? to_flash : to_hour) * 60;
+}
+
+int64_t flash_next_deadline(const flash_state_t *f, const fade_table_t *t, int64_t now_ns) {
+  if (!f->active) return 0;
+  size_t k = fade_step_at(t, now_ns - f->start_ns);
+  int64_t next = (k + 1 < t->n) ? t->steps[k + 1].at_ns : (int64_t)FLASH_DURATION_SEC * NS_PER_SEC;
+  int64_t deadline = f->start_ns + next;
+  int64_t earliest = now_ns + (int64_t)FLASH_STEP_MS * NS_PER_MS;
+  return deadline > earliest ? deadline : earliest;
+}
+
+colors_t flash_colors(const flash_state_t *f, const fade_table_t *t, const options_t *opt,
+                      int64_t now_ns, size_t *step) {
+  // - Normal: use configured fg/bg.
+  // - Flash: background fades from inverted(orig_bg) -> orig_bg over 30s;
+  //          foreground is always inverse of CURRENT background.
+  if (f->active) {
+    size_t k = fade_step_at(t, now_ns - f->start_ns);
+    if (step) *step = k;
+    return t->steps[k].colors;
+  }
+  if (step) *step = 0;
+  colors_t c = {
+    .fg_r = opt->fg_r, .fg_g = opt->fg_g, .fg_b = opt->fg_b,
+    .bg_r = opt->bg_r, .bg_g = opt->bg_g, .bg_b = opt->bg_b
+  };
+  return c;
+}
+
+uint32_t flash_opacity(const flash_state_t *f, const fade_table_t *t, int64_t now_ns) {
+  if (!f->active) return 0;
+  size_t k = fade_step_at(t, now_ns - f->start_ns);
+  return (uint32_t)((double)0xffffffffu * (double)(t->n - k) / (double)t->n + 0.5);
+}
@@ -0,0 +1,71 @@
+// flash: boundary-aligned flash trigger and its precomputed color fade.
+#ifndef FLASH_H
+#define FLASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "overlay.h"
+
+#define FLASH_DURATION_SEC 30
+#define FLASH_STEP_MS 50      // minimum interval between fade frames
+#define FADE_MIN_DELTA 1      // smallest per-frame change, in 8-bit channel units
+#define FADE_MAX_STEPS 256
+
+typedef struct {
+  bool active;
+  int64_t start_ns;             // CLOCK_MONOTONIC time of the trigger
+  long last_boundary_min_epoch; // epoch minutes of last trigger
+  uint64_t count;               // flashes since program start
+} flash_state_t;
+
+// One distinct quantized color of the flash fade and when it starts.
+typedef struct {
+  int64_t at_ns;  // offset from flash start
+  colors_t colors;
+} fade_step_t;
+
+// Precomputed fade: background goes from inverted(bg) to bg over
+// FLASH_DURATION_SEC, foreground is the inverse of the current background.
+// Consecutive steps differ by at least FADE_MIN_DELTA on some 8-bit channel,
+// so every fade wakeup produces a visibly different frame.
+typedef struct {
+  fade_step_t steps[FADE_MAX_STEPS];
+  size_t n;
+} fade_table_t;
+
+void flash_init(flash_state_t *f);
+void fade_table_init(fade_table_t *t, const options_t *opt);
+
+// Index of the fade step in effect elapsed_ns after the flash started.
+size_t fade_step_at(const fade_table_t *t, int64_t elapsed_ns);
+
+// Starts or ends the flash for the second described by lt/now (realtime) at
+// monotonic time now_ns. Returns true if it started or ended.
+bool flash_update(flash_state_t *f, const options_t *opt, const struct tm *lt, time_t now, int64_t now_ns);
+
+// Start of the next minute that can trigger a flash after the second
+// described by lt/now: the next multiple of flash_minutes, or the next local
+// hour if that comes first (the minute count restarts there). Lets a clock
+// that changes less often than every minute still wake for its flashes.
+// Returns 0 when flashes are disabled.
+time_t flash_next_boundary(const options_t *opt, const struct tm *lt, time_t now);
+
+// Monotonic deadline of the next fade wakeup: when the next step begins (or
+// the flash ends), but never sooner than FLASH_STEP_MS after now_ns. Returns
+// 0 when no flash is active.
+int64_t flash_next_deadline(const flash_state_t *f, const fade_table_t *t, int64_t now_ns);
+
+// Colors to draw with at now_ns: the configured ones, or the current step of
+// an active fade. *step receives the fade step index (0 when inactive).
+colors_t flash_colors(const flash_state_t *f, const fade_table_t *t, const options_t *opt,
+                      int64_t now_ns, size_t *step);
+
+// _NET_WM_WINDOW_OPACITY for the inverted layer of a compositor-driven flash
+// at now_ns: opaque at the start, fading out on the same step times as the
+// color table, so cross-fading the layer over the normal frame yields the
+// same background as flash_colors. 0 when no flash is active.
+uint32_t flash_opacity(const flash_state_t *f, const fade_table_t *t, int64_t now_ns);
+
+#endif
@@ -0,0 +1,59 @@
+// fontload: font and atlas preparation off the main thread. See fontload.h.
+#define _POSIX_C_SOURCE 200809L
+#include "fontload.h"
+
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static void fontload_run(fontload_t *fl) {
+  fl->font_ok = render_init(fl->r, &fl->opt, fl->charset);
+  fl->atlas_ok = fl->font_ok && render_atlas_prepare(fl->r);
+}
+
+static void *fontload_thread(void *arg) {
+  fontload_t *fl = arg;
+  fontload_run(fl);
+  uint64_t one = 1;
+  ssize_t n = write(fl->efd, &one, sizeof(one));  // only fails on overflow
+  (void)n;
+  return NULL;
+}
+
+void fontload_start(fontload_t *fl, render_t *r, const options_t *opt, const char *charset) {
+  memset(fl, 0, sizeof(*fl));
+  fl->r = r;
+  fl->opt = *opt;
+  strncpy(fl->charset, charset ? charset : "", sizeof(fl->charset) - 1);
+  fl->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  // The worker starts with every signal blocked, so process-directed ones
+  // (SIGUSR1, SIGHUP...) always reach the main thread and its signalfd.
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  bool started = fl->efd >= 0 && pthread_create(&fl->thread, NULL, fontload_thread, fl) == 0;
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (started) {
+    fl->running = true;
+    return;
+  }
+  if (fl->efd >= 0) close(fl->efd);
+  fl->efd = -1;
+  fontload_run(fl);
+}
+
+int fontload_fd(const fontload_t *fl) {
+  return fl->running ? fl->efd : -1;
+}
+
+bool fontload_finish(fontload_t *fl) {
+  if (fl->running) {
+    pthread_join(fl->thread, NULL);
+    fl->running = false;
+    close(fl->efd);
+    fl->efd = -1;
+  }
+  return fl->font_ok;
+}
@@ -0,0 +1,37 @@
+// fontload: resolves the font and rasterizes the glyph atlas on a worker
+// thread (render_init + render_atlas_prepare), so the main thread can do
+// the X setup and map the window meanwhile. Completion is signalled through
+// an eventfd that the event loop polls; only the upload of the atlas to the
+// server is left for the main thread.
+#ifndef FONTLOAD_H
+#define FONTLOAD_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "render.h"
+
+typedef struct {
+  render_t *r;
+  options_t opt;   // copied; its strings are read until the thread is done
+  char charset[ATLAS_CHARS_MAX];
+  pthread_t thread;
+  bool running;   // thread started and not joined yet
+  int efd;        // readable once the thread is done, -1 if none
+  bool font_ok;   // render_init succeeded
+  bool atlas_ok;  // render_atlas_prepare succeeded
+} fontload_t;
+
+// Starts loading into r; opt's strings must stay valid until
+// fontload_finish(). If the thread (or its eventfd) cannot be created
+// the work is done right here, and fontload_fd() returns -1.
+void fontload_start(fontload_t *fl, render_t *r, const options_t *opt, const char *charset);
+
+// Pollable fd that becomes readable when loading is done; -1 once done.
+int fontload_fd(const fontload_t *fl);
+
+// Waits for the worker and releases it. Returns whether the font loaded;
+// r is only safe to use from the calling thread afterwards.
+bool fontload_finish(fontload_t *fl);
+
+#endif
@@ -0,0 +1,29 @@
+// frame: one laid-out line of text and its damage, shared by the Cairo
+// renderer (render.h) and the built-in bitmap font (bitmap.h).
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "overlay.h"
+
+#define FRAME_TEXT_MAX 128
+
+// Everything needed to paint one frame, and to diff it against the next.
+typedef struct {
+  char str[FRAME_TEXT_MAX];
+  bool use_atlas;
+  double x_advance, x_bearing;
+  uint16_t w, h;          // window size
+  double text_x, text_y;  // pen origin and baseline
+  colors_t colors;
+} frame_t;
+
+// What to repaint: the whole frame, or the column span [x0, x1).
+typedef struct {
+  bool full;
+  int x0, x1;
+} damage_t;
+
+#endif
@@ -0,0 +1,98 @@
+// linemask: XRender line-mask compositing. See linemask.h.
+#define _POSIX_C_SOURCE 200809L
+#include "linemask.h"
+
+#include <string.h>
+
+#include <cairo/cairo-xcb.h>
+
+bool linemask_init(linemask_t *lm, const xcb_render_query_pict_formats_reply_t *formats,
+                   xcb_visualid_t visual) {
+  memset(lm, 0, sizeof(*lm));
+  bool have_a8 = false;
+  xcb_render_pictforminfo_iterator_t fi = xcb_render_query_pict_formats_formats_iterator(formats);
+  for (; fi.rem && !have_a8; xcb_render_pictforminfo_next(&fi)) {
+    const xcb_render_pictforminfo_t *f = fi.data;
+    if (f->type == XCB_RENDER_PICT_TYPE_DIRECT && f->depth == 8 && f->direct.alpha_mask == 0xff &&
+        !f->direct.red_mask && !f->direct.green_mask && !f->direct.blue_mask) {
+      lm->a8 = *f;
+      have_a8 = true;
+    }
+  }
+
+  xcb_render_pictscreen_iterator_t si = xcb_render_query_pict_formats_screens_iterator(formats);
+  for (; si.rem && !lm->dst_format; xcb_render_pictscreen_next(&si)) {
+    xcb_render_pictdepth_iterator_t di = xcb_render_pictscreen_depths_iterator(si.data);
+    for (; di.rem && !lm->dst_format; xcb_render_pictdepth_next(&di)) {
+      xcb_render_pictvisual_iterator_t vi = xcb_render_pictdepth_visuals_iterator(di.data);
+      for (; vi.rem; xcb_render_pictvisual_next(&vi)) {
+        if (vi.data->visual == visual) {
+          lm->dst_format = vi.data->format;
+          break;
+        }
+      }
+    }
+  }
+  return have_a8 && lm->dst_format;
+}
+
+static void mask_release(linemask_t *lm, xcb_connection_t *c) {
+  if (lm->mask_cr) cairo_destroy(lm->mask_cr);
+  if (lm->mask_surface) cairo_surface_destroy(lm->mask_surface);
+  if (lm->mask_pic) xcb_render_free_picture(c, lm->mask_pic);
+  if (lm->mask_pixmap) xcb_free_pixmap(c, lm->mask_pixmap);
+  lm->mask_cr = NULL;
+  lm->mask_surface = NULL;
+  lm->mask_pic = 0;
+  lm->mask_pixmap = 0;
+  lm->w = lm->h = 0;
+}
+
+bool linemask_ensure(linemask_t *lm, xcb_connection_t *c, xcb_screen_t *screen,
+                     xcb_drawable_t like, uint16_t w, uint16_t h) {
+  if (lm->mask_cr && lm->w == w && lm->h == h) return false;
+  mask_release(lm, c);
+  lm->mask_pixmap = xcb_generate_id(c);
+  xcb_create_pixmap(c, 8, lm->mask_pixmap, like, w, h);
+  lm->mask_pic = xcb_generate_id(c);
+  xcb_render_create_picture(c, lm->mask_pic, lm->mask_pixmap, lm->a8.id, 0, NULL);
+  lm->mask_surface = cairo_xcb_surface_create_with_xrender_format(c, screen, lm->mask_pixmap, &lm->a8, w, h);
+  lm->mask_cr = cairo_create(lm->mask_surface);
+  lm->w = w;
+  lm->h = h;
+  return true;
+}
+
+static xcb_render_color_t render_color(double r, double g, double b) {
+  xcb_render_color_t col = {
+    .red = (uint16_t)(r * 0xffff + 0.5),
+    .green = (uint16_t)(g * 0xffff + 0.5),
+    .blue = (uint16_t)(b * 0xffff + 0.5),
+    .alpha = 0xffff
+  };
+  return col;
+}
+
+void linemask_composite(linemask_t *lm, xcb_connection_t *c, xcb_render_picture_t dst,
+                        const colors_t *colors, int16_t x0, int16_t x1) {
+  if (!lm->fg_pic || lm->fg_color.fg_r != colors->fg_r || lm->fg_color.fg_g != colors->fg_g ||
+      lm->fg_color.fg_b != colors->fg_b) {
+    if (lm->fg_pic) xcb_render_free_picture(c, lm->fg_pic);
+    lm->fg_pic = xcb_generate_id(c);
+    xcb_render_create_solid_fill(c, lm->fg_pic, render_color(colors->fg_r, colors->fg_g, colors->fg_b));
+    lm->fg_color = *colors;
+  }
+
+  uint16_t w = (uint16_t)(x1 - x0);
+  xcb_rectangle_t rect = { x0, 0, w, lm->h };
+  xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, dst,
+                             render_color(colors->bg_r, colors->bg_g, colors->bg_b), 1, &rect);
+  xcb_render_composite(c, XCB_RENDER_PICT_OP_OVER, lm->fg_pic, lm->mask_pic, dst,
+                       0, 0, x0, 0, x0, 0, w, lm->h);
+}
+
+void linemask_destroy(linemask_t *lm, xcb_connection_t *c) {
+  mask_release(lm, c);
+  if (lm->fg_pic) xcb_render_free_picture(c, lm->fg_pic);
+  lm->fg_pic = 0;
+}
@@ -0,0 +1,49 @@
+// linemask: XRender compositing for --backend xrender. The text is kept
+// rasterized in an A8 mask pixmap that only changes where characters change;
+// every frame is then a solid background fill plus one Composite of a solid
+// foreground through the mask, so color-only frames (flash fades) cost two
+// small requests and no rasterization at all.
+#ifndef LINEMASK_H
+#define LINEMASK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+#include <cairo/cairo.h>
+
+#include "overlay.h"
+
+typedef struct {
+  xcb_render_pictforminfo_t a8;          // mask format
+  xcb_render_pictformat_t dst_format;    // format of the window visual
+  xcb_pixmap_t mask_pixmap;
+  xcb_render_picture_t mask_pic;
+  cairo_surface_t *mask_surface;         // cairo view of mask_pixmap
+  cairo_t *mask_cr;
+  uint16_t w, h;
+  xcb_render_picture_t fg_pic;           // solid fill of fg_color
+  colors_t fg_color;
+} linemask_t;
+
+// Picks the A8 and visual formats out of a QueryPictFormats reply. Returns
+// false if either is missing (the caller then falls back to plain cairo).
+bool linemask_init(linemask_t *lm, const xcb_render_query_pict_formats_reply_t *formats,
+                   xcb_visualid_t visual);
+
+// Makes the mask w x h. Returns true if it was (re)created, in which case
+// it must be repainted in full.
+bool linemask_ensure(linemask_t *lm, xcb_connection_t *c, xcb_screen_t *screen,
+                     xcb_drawable_t like, uint16_t w, uint16_t h);
+
+// Fills [x0, x1) of dst with the background and composites the foreground
+// through the mask on top. dst is the caller's picture of its back buffer,
+// in dst_format, kept for as long as the pixmap so a frame is only these two
+// requests. The mask's cairo surface must be flushed first.
+void linemask_composite(linemask_t *lm, xcb_connection_t *c, xcb_render_picture_t dst,
+                        const colors_t *colors, int16_t x0, int16_t x1);
+
+void linemask_destroy(linemask_t *lm, xcb_connection_t *c);
+
+#endif
@@ -1,5 +1,6 @@
 // x11-datetime-overlay: Always-on-top top-right datetime overlay
-// Pure C using XCB + cairo (xcb backend). Minimal CPU/GPU footprint.
+// Pure C using XCB + cairo (xcb backend), or XCB alone with the built-in
+// bitmap font (--backend bitmap, -Dcairo=disabled). Minimal CPU/GPU footprint.
 // Builds with meson and gcc.
 #define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
@@ -9,44 +10,160 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
-#include <poll.h>
-#include <ctype.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <errno.h>
 #include <getopt.h>
 
 #include <xcb/xcb.h>
 #include <xcb/xproto.h>
 #include <xcb/shape.h>
+#include <xcb/screensaver.h>
+#include <xcb/dpms.h>
+#ifdef HAVE_CAIRO
+#include <xcb/render.h>
 #include <cairo/cairo.h>
 #include <cairo/cairo-xcb.h>
+#endif
 
-#define FLASH_DURATION_SEC 30
-#define FLASH_STEP_MS 50
+#include "overlay.h"
+#include "bitmap.h"
+#include "control.h"
+#include "displaydir.h"
+#include "flash.h"
+#include "outputs.h"
+#include "settings.h"
+#include "status.h"
+#include "stats.h"
+#include "timefmt.h"
+#include "vsync.h"
+#ifdef HAVE_CAIRO
+#include "bench.h"
+#include "fontload.h"
+#include "linemask.h"
+#include "render.h"
+#include "shmbuf.h"
+#define DEFAULT_BACKEND BACKEND_XCB
+#else
+#define DEFAULT_BACKEND BACKEND_BITMAP
+#endif
 
+// Last geometry and stacking applied to (or reported for) the window, so
+// ConfigureWindow is only sent for fields that actually change.
 typedef struct {
-  const char *font_family;
-  double font_size_px;
-  uint32_t margin_px;
-  double fg_r, fg_g, fg_b;
-  double bg_r, bg_g, bg_b;
-  bool time_only;
-  bool debug;
-  int flash_minutes; // 0 disables
-  bool show_flash_count;
-} options_t;
+  int16_t x, y;
+  uint16_t w, h;
+  bool obscured;      // last VisibilityNotify said we are (partly) covered
+  bool raise_pending; // restack once in response to being covered
+} geometry_t;
 
+// Reasons nobody can see the overlay. While any holds, the tick and fade
+// timers are disarmed and the process sleeps until an X event says otherwise.
 typedef struct {
-  bool active;
-  time_t start;
-  long last_boundary_min_epoch; // epoch minutes of last trigger
-} flash_state_t;
+  bool fully_obscured;  // VisibilityNotify FullyObscured
+  bool saver_active;    // MIT-SCREEN-SAVER reports the saver on
+  bool dpms_off;        // DPMS reports the monitor in standby/suspend/off
+  bool suspended;       // timers currently disarmed
+  uint8_t saver_event;  // first_event of MIT-SCREEN-SAVER, 0 if absent
+  bool have_dpms;
+} idle_state_t;
+
+// Off-screen copy of the window contents. Lives as long as the window and is
+// only recreated when the window size changes; frames are drawn here and
+// presented with a single CopyArea, or a single ShmPutImage when the buffer
+// lives in MIT-SHM (--backend shm). The bitmap backend only needs the
+// pixmap (pixmap_only): it uploads finished pixels with PutImage.
+typedef struct {
+  xcb_pixmap_t pixmap;      // all but the shm backend
+  uint16_t w, h;
+  bool pixmap_only;
+  bool use_shm;
+#ifdef HAVE_CAIRO
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  cairo_format_t shm_format;
+  shmbuf_t shm;             // kept across resizes, released at exit
+  xcb_render_pictformat_t pict_format;  // nonzero: keep an XRender picture of pixmap
+  xcb_render_picture_t picture;         // (--backend xrender draws through it)
+#endif
+} backbuf_t;
+
+// What turns a clock string into pixels: cairo with the glyph atlas, or the
+// built-in bitmap font. Both lay out fixed cells and report damage the same
+// way, so the loop and the flash layer do not care which one it is.
+typedef struct {
+  bool bitmap;
+  bitmap_t bm;
+#ifdef HAVE_CAIRO
+  render_t render;
+#endif
+} painter_t;
+
+// --flash-mode compositor: a second window stacked right above each overlay
+// shows the frame with inverted colors and is faded out through
+// _NET_WM_WINDOW_OPACITY, so the compositor does the cross-fade and a fade
+// step is a single property change with nothing repainted. The inverted
+// frame is drawn once and shared by every overlay's layer window.
+typedef struct {
+  bool enabled;       // false when the client fades the colors itself
+  backbuf_t bb;
+  frame_t last;
+  uint32_t opacity;
+} flash_layer_t;
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1); empty when x0 >= x1.
+typedef struct {
+  int x0, y0, x1, y1;
+} rect_t;
+
+static bool rect_empty(const rect_t *r) {
+  return r->x0 >= r->x1 || r->y0 >= r->y1;
+}
+
+static void rect_union(rect_t *r, int x0, int y0, int x1, int y1) {
+  if (x0 >= x1 || y0 >= y1) return;
+  if (rect_empty(r)) {
+    *r = (rect_t){ x0, y0, x1, y1 };
+    return;
+  }
+  if (x0 < r->x0) r->x0 = x0;
+  if (y0 < r->y0) r->y0 = y0;
+  if (x1 > r->x1) r->x1 = x1;
+  if (y1 > r->y1) r->y1 = y1;
+}
+
+// One overlay window: a single one anchored to the whole root, or one per
+// monitor with --outputs. Font, atlas, back buffer and timers are shared, so
+// N overlays still cost one format and one rasterization per tick; each
+// window only adds its ConfigureWindow (when needed) and its CopyArea.
+typedef struct {
+  xcb_randr_crtc_t crtc;    // 0 for the whole-root overlay
+  int16_t area_x, area_y;   // rectangle the overlay anchors to (top right)
+  uint16_t area_w, area_h;
+  bool place_dirty;         // area changed since place_x/y were computed
+  uint16_t placed_w;        // frame width place_x/y were computed for
+  int16_t place_x, place_y; // cached top-right anchored position
+  xcb_window_t win;
+  geometry_t geom;
+  bool fully_obscured;
+  bool present_all;         // window contents unknown; copy the whole frame
+  rect_t exposed;           // union of the Expose rectangles since the last present
+  bool raised;              // restacked this tick (the layer follows)
+  xcb_window_t layer_win;   // flash layer above win, 0 without one
+  geometry_t layer_geom;
+  bool layer_mapped;
+  bool layer_present_all;
+} overlay_t;
 
 static void print_help(const char *prog) {
   fprintf(stdout,
     "x11-datetime-overlay - tiny always-on-top datetime overlay (XCB)\n"
     "\n"
     "Usage:\n"
-    "  %s [--font FAMILY] [--size PX] [--fg #RRGGBB] [--bg #RRGGBB] [--margin PX] [--time-only] [--flash MIN] [--show-flash-count] [--debug]\n"
+    "  %s [--font FAMILY] [--size PX] [--fg #RRGGBB] [--bg #RRGGBB] [--margin PX] [--time-only | --format FMT] [--zone NAME]... [--status LIST] [--flash MIN] [--show-flash-count] [--flash-mode client|compositor] [--backend xcb|shm|xrender|bitmap] [--outputs LIST] [--precision ms|cs] [--render-ahead MS] [--no-atlas-cache] [--displays LIST | --display-dir DIR] [--config FILE] [--control PATH] [--stats [--stats-file PATH]] [--stats-budget REQUESTS[,BYTES]] [--exit-after SEC] [--debug]\n"
+    "  %s --bench N [options]\n"
     "  %s -h | --help\n"
     "\n"
     "Options:\n"
@@ -56,45 +173,53 @@ static void print_help(const char *prog) {
     "      --bg  #RRGGBB     Background color (default: #000000).\n"
     "  -m, --margin PX       Outer margin from screen edges in pixels (default: 0).\n"
     "  -t, --time-only       Show only time (HH:MM:SS), omit the date.\n"
+    "      --format FMT      strftime-like template, plus %%{flash}, %%{week} and %%{ms}\n"
+    "                        (default: \"%%Y-%%m-%%d %%H:%%M:%%S\"). Wakes only as often as\n"
+    "                        its fastest field changes.\n"
+    "      --zone NAME       Also show the time in zone NAME (e.g. UTC,\n"
+    "                        America/New_York) after the local time; repeatable (up to 4).\n"
+    "      --status LIST     Segments after the clock: loadavg, battery[=NAME] and\n"
+    "                        countdown=HH:MM (e.g. loadavg,countdown=17:30).\n"
     "  -F, --flash MIN       Boundary flash at minute %% MIN == 0 (sec==00), fade 30s.\n"
     "  -c, --show-flash-count Append \"(N)\" with total flashes since start (N>0).\n"
+    "      --flash-mode MODE client (default) repaints each fade step; compositor\n"
+    "                        lets a running compositor cross-fade an inverted layer.\n"
+    "      --backend NAME    Frame path: xcb (default), shm (MIT-SHM, local only),\n"
+    "                        xrender (text mask composited server side) or bitmap\n"
+    "                        (built-in pixel font, no cairo).\n"
+    "      --outputs LIST    One overlay per monitor (RandR): all, primary or output names (DP-1,HDMI-1).\n"
+    "      --precision P     Show milliseconds (ms) or centiseconds (cs), repainted on\n"
+    "                        every display refresh (Present).\n"
+    "      --render-ahead MS Paint each tick's frame MS ms before its boundary and only\n"
+    "                        copy it to the screen on time (xcb/xrender backends).\n"
+    "      --no-atlas-cache  Always load the font and rasterize the glyph atlas instead\n"
+    "                        of reusing the one cached in $XDG_CACHE_HOME.\n"
+    "      --displays LIST   Show the overlay on several X displays from one process\n"
+    "                        (e.g. :0,:1); the font and clock string are shared.\n"
+    "      --display-dir DIR Show it on every X server with a socket in DIR (e.g.\n"
+    "                        /tmp/.X11-unix), including ones started later.\n"
+    "      --config FILE     Read \"key = value\" settings (font, size, fg, bg, margin,\n"
+    "                        time-only, format, flash, show-flash-count) from FILE;\n"
+    "                        SIGHUP re-reads it. Command-line values take precedence.\n"
+    "      --control PATH    Accept \"set KEY VALUE\", \"reload\" and \"show\" commands on\n"
+    "                        a UNIX socket at PATH.\n"
     "  -d, --debug           Verbose debug logs to stderr.\n"
+    "      --bench N         Run N ticks offscreen (no X) and print per-stage timings.\n"
+    "      --stats           Collect per-stage timing histograms; dump them on SIGUSR1.\n"
+    "      --stats-file PATH Append --stats dumps to PATH instead of stderr (implies --stats).\n"
+    "      --stats-budget REQUESTS[,BYTES]\n"
+    "                        With --exit-after: exit with status 3 if the mean X\n"
+    "                        requests (bytes) per tick exceed these (implies --stats).\n"
+    "                        With --flash the run is timed from the first flash.\n"
+    "      --exit-after SEC  Exit after SEC seconds, dumping --stats first.\n"
     "  -h, --help            Show this help and exit.\n"
     "\n"
     "Example:\n"
     "  %s --time-only --flash 1 --show-flash-count --font \"DejaVu Sans Mono\" --size 18 --fg #EAEAEA --bg #101010 --margin 10\n",
-    prog, prog, prog
+    prog, prog, prog, prog
   );
 }
 
-static int parse_hex2(const char *p) {
-  int v = 0;
-  for (int i = 0; i < 2; ++i) {
-    char c = p[i];
-    if (!isxdigit((unsigned char)c)) return -1;
-    v <<= 4;
-    if (c >= '0' && c <= '9') v |= (c - '0');
-    else if (c >= 'a' && c <= 'f') v |= (c - 'a' + 10);
-    else if (c >= 'A' && c <= 'F') v |= (c - 'A' + 10);
-  }
-  return v;
-}
-
-static bool parse_rgb_hex(const char *hex, double *r, double *g, double *b) {
-  // Accept "#RRGGBB" or "RRGGBB"
-  const char *p = hex;
-  if (hex[0] == '#') p++;
-  if (strlen(p) != 6) return false;
-  int rr = parse_hex2(p);
-  int gg = parse_hex2(p+2);
-  int bb = parse_hex2(p+4);
-  if (rr < 0 || gg < 0 || bb < 0) return false;
-  *r = rr / 255.0;
-  *g = gg / 255.0;
-  *b = bb / 255.0;
-  return true;
-}
-
 static xcb_visualtype_t *get_visualtype_for_screen(const xcb_setup_t *setup, xcb_screen_t *screen) {
   (void)setup; // silence unused parameter warning
   xcb_depth_iterator_t di = xcb_screen_allowed_depths_iterator(screen);
@@ -109,14 +234,45 @@ static xcb_visualtype_t *get_visualtype_for_screen(const xcb_setup_t *setup, xcb
   return NULL;
 }
 
-static void intern_atom(xcb_connection_t *c, const char *name, xcb_atom_t *out) {
-  xcb_intern_atom_cookie_t ck = xcb_intern_atom(c, 0, strlen(name), name);
-  xcb_intern_atom_reply_t *rp = xcb_intern_atom_reply(c, ck, NULL);
-  if (rp) {
-    *out = rp->atom;
-    free(rp);
-  } else {
-    *out = XCB_ATOM_NONE;
+// Atoms used by the overlay. All InternAtom requests are sent up front and
+// the replies collected later, so startup pays one round trip, not one each.
+enum {
+  ATOM_NET_WM_WINDOW_TYPE,
+  ATOM_NET_WM_WINDOW_TYPE_DOCK,
+  ATOM_NET_WM_STATE,
+  ATOM_NET_WM_STATE_ABOVE,
+  ATOM_NET_WM_STATE_STICKY,
+  ATOM_NET_WM_DESKTOP,
+  ATOM_NET_WM_WINDOW_OPACITY,
+  ATOM_COUNT
+};
+
+static const char *const atom_names[ATOM_COUNT] = {
+  [ATOM_NET_WM_WINDOW_TYPE]      = "_NET_WM_WINDOW_TYPE",
+  [ATOM_NET_WM_WINDOW_TYPE_DOCK] = "_NET_WM_WINDOW_TYPE_DOCK",
+  [ATOM_NET_WM_STATE]            = "_NET_WM_STATE",
+  [ATOM_NET_WM_STATE_ABOVE]      = "_NET_WM_STATE_ABOVE",
+  [ATOM_NET_WM_STATE_STICKY]     = "_NET_WM_STATE_STICKY",
+  [ATOM_NET_WM_DESKTOP]          = "_NET_WM_DESKTOP",
+  [ATOM_NET_WM_WINDOW_OPACITY]   = "_NET_WM_WINDOW_OPACITY",
+};
+
+static void intern_atoms_send(xcb_connection_t *c, xcb_intern_atom_cookie_t ck[ATOM_COUNT]) {
+  for (int i = 0; i < ATOM_COUNT; ++i) {
+    ck[i] = xcb_intern_atom(c, 0, strlen(atom_names[i]), atom_names[i]);
+  }
+}
+
+static void intern_atoms_collect(xcb_connection_t *c, xcb_intern_atom_cookie_t ck[ATOM_COUNT],
+                                 xcb_atom_t out[ATOM_COUNT]) {
+  for (int i = 0; i < ATOM_COUNT; ++i) {
+    xcb_intern_atom_reply_t *rp = xcb_intern_atom_reply(c, ck[i], NULL);
+    if (rp) {
+      out[i] = rp->atom;
+      free(rp);
+    } else {
+      out[i] = XCB_ATOM_NONE;
+    }
   }
 }
 
@@ -129,18 +285,14 @@ static const char *event_name(uint8_t rt) {
   }
 }
 
-static void set_evmh_hints(xcb_connection_t *c, xcb_window_t win) {
+static void set_evmh_hints(xcb_connection_t *c, xcb_window_t win, const xcb_atom_t atoms[ATOM_COUNT]) {
   // Best-effort EWMH hints: set type DOCK, stick to all desktops, keep ABOVE+STICKY
-  xcb_atom_t _NET_WM_WINDOW_TYPE, _NET_WM_WINDOW_TYPE_DOCK;
-  xcb_atom_t _NET_WM_STATE, _NET_WM_STATE_ABOVE, _NET_WM_STATE_STICKY;
-  xcb_atom_t _NET_WM_DESKTOP;
-
-  intern_atom(c, "_NET_WM_WINDOW_TYPE", & _NET_WM_WINDOW_TYPE);
-  intern_atom(c, "_NET_WM_WINDOW_TYPE_DOCK", & _NET_WM_WINDOW_TYPE_DOCK);
-  intern_atom(c, "_NET_WM_STATE", & _NET_WM_STATE);
-  intern_atom(c, "_NET_WM_STATE_ABOVE", & _NET_WM_STATE_ABOVE);
-  intern_atom(c, "_NET_WM_STATE_STICKY", & _NET_WM_STATE_STICKY);
-  intern_atom(c, "_NET_WM_DESKTOP", & _NET_WM_DESKTOP);
+  xcb_atom_t _NET_WM_WINDOW_TYPE = atoms[ATOM_NET_WM_WINDOW_TYPE];
+  xcb_atom_t _NET_WM_WINDOW_TYPE_DOCK = atoms[ATOM_NET_WM_WINDOW_TYPE_DOCK];
+  xcb_atom_t _NET_WM_STATE = atoms[ATOM_NET_WM_STATE];
+  xcb_atom_t _NET_WM_STATE_ABOVE = atoms[ATOM_NET_WM_STATE_ABOVE];
+  xcb_atom_t _NET_WM_STATE_STICKY = atoms[ATOM_NET_WM_STATE_STICKY];
+  xcb_atom_t _NET_WM_DESKTOP = atoms[ATOM_NET_WM_DESKTOP];
 
   if (_NET_WM_WINDOW_TYPE != XCB_ATOM_NONE && _NET_WM_WINDOW_TYPE_DOCK != XCB_ATOM_NONE) {
     xcb_change_property(
@@ -172,34 +324,1454 @@ static void set_evmh_hints(xcb_connection_t *c, xcb_window_t win) {
   }
 }
 
-static void now_timestr(char *buf, size_t bufsz, bool time_only) {
-  time_t t = time(NULL);
-  struct tm lt;
-  localtime_r(&t, &lt);
-  const char *fmt = time_only ? "%H:%M:%S" : "%Y-%m-%d %H:%M:%S";
-  strftime(buf, bufsz, fmt, &lt);
+// Creates an unmapped override-redirect window (so the WM doesn't manage it
+// and it stays above), click-through and with the EWMH hints set.
+static xcb_window_t create_overlay_window(xcb_connection_t *c, xcb_screen_t *screen,
+                                          int16_t x, int16_t y, uint16_t w, uint16_t h,
+                                          uint32_t event_mask, const xcb_atom_t atoms[ATOM_COUNT]) {
+  xcb_window_t win = xcb_generate_id(c);
+  uint32_t cw_values[2];
+  uint32_t cw_mask = XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK;
+  cw_values[0] = 1; // override-redirect = true
+  cw_values[1] = event_mask;
+  xcb_create_window(
+    c,
+    XCB_COPY_FROM_PARENT,              // depth
+    win,
+    screen->root,
+    x, y,
+    w, h,
+    0,                                // border
+    XCB_WINDOW_CLASS_INPUT_OUTPUT,
+    screen->root_visual,
+    cw_mask, cw_values
+  );
+
+  // Make the window click-through (no input), so it never steals focus.
+  xcb_shape_rectangles(
+    c,
+    XCB_SHAPE_SO_SET,
+    XCB_SHAPE_SK_INPUT,
+    XCB_CLIP_ORDERING_UNSORTED,
+    win,
+    0, 0,
+    0,
+    NULL
+  );
+
+  set_evmh_hints(c, win, atoms);
+  return win;
+}
+
+// Arms tfd to fire once at the absolute CLOCK_REALTIME instant at (a past
+// instant fires right away). Each frame re-arms it for the next change of
+// the format plan, so an HH:MM clock wakes once a minute. With
+// TFD_TIMER_CANCEL_ON_SET a clock step (NTP, settime, resume from suspend)
+// makes the pending read fail with ECANCELED, so the caller can re-sync
+// right away instead of showing a stale second.
+static bool tick_timer_arm(int tfd, const struct timespec *at) {
+  struct itimerspec its = { .it_value = *at };
+  return timerfd_settime(tfd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its, NULL) == 0;
+}
+
+// Consumes a readable tick timer. Returns true if the clock was set since it
+// was armed; the next frame re-arms it on the new timeline.
+static bool tick_timer_read(int tfd) {
+  uint64_t expirations;
+  ssize_t n = read(tfd, &expirations, sizeof(expirations));
+  return n < 0 && errno == ECANCELED;
+}
+
+static struct timespec ts_add_ns(struct timespec t, int64_t ns) {
+  int64_t total = (int64_t)t.tv_nsec + ns;
+  t.tv_sec += (time_t)(total / NS_PER_SEC);
+  t.tv_nsec = (long)(total % NS_PER_SEC);
+  if (t.tv_nsec < 0) {
+    t.tv_nsec += NS_PER_SEC;
+    t.tv_sec -= 1;
+  }
+  return t;
+}
+
+static int64_t ts_diff_ns(const struct timespec *a, const struct timespec *b) {
+  return (int64_t)(a->tv_sec - b->tv_sec) * NS_PER_SEC + (a->tv_nsec - b->tv_nsec);
+}
+
+// Realtime instant of the next tick after the frame formatted for now: the
+// plan's next change, an earlier minute that can start a flash, or a status
+// segment's deadline. When vblanks pace the sub-second digits (paced) the
+// timer only covers second boundaries. Returns false if nothing but events can change the frame.
+static bool tick_next(const timefmt_t *tf, const status_t *status, const options_t *opt, const struct tm *lt,
+                      const struct timespec *now, bool paced, struct timespec *at) {
+  bool have = timefmt_next_change(tf, now, at);
+  if (paced && tf->unit == TF_UNIT_SUBSEC) *at = (struct timespec){ now->tv_sec + 1, 0 };
+  time_t flash_at = flash_next_boundary(opt, lt, now->tv_sec);
+  if (flash_at && (!have || flash_at < at->tv_sec)) {
+    *at = (struct timespec){ flash_at, 0 };
+    have = true;
+  }
+  // Status segments wake the loop only when no earlier tick carries them.
+  struct timespec status_at;
+  if (status_next(status, &status_at) && (!have || ts_diff_ns(&status_at, at) < 0)) {
+    *at = status_at;
+    have = true;
+  }
+  return have;
+}
+
+// --debug startup timeline: time since process start at each phase, so
+// time-to-first-frame can be tracked as a regression metric.
+static void startup_mark(const options_t *opt, int64_t t0_ns, const char *phase) {
+  if (!opt->debug) return;
+  fprintf(stderr, "[debug] startup +%.3fms %s\n", (double)(mono_now_ns() - t0_ns) / 1e6, phase);
+}
+
+// Arms the CLOCK_MONOTONIC fade timer at an absolute deadline (0 disarms).
+static void fade_timer_arm(int fd, int64_t deadline_ns) {
+  struct itimerspec its = {0};
+  if (deadline_ns > 0) {
+    its.it_value.tv_sec = (time_t)(deadline_ns / NS_PER_SEC);
+    its.it_value.tv_nsec = (long)(deadline_ns % NS_PER_SEC);
+  }
+  timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static bool idle_hidden(const idle_state_t *idle) {
+  return idle->fully_obscured || idle->saver_active || idle->dpms_off;
+}
+
+// DPMS has no change events we can rely on, but the server activates the
+// screen saver whenever DPMS leaves On, so this is only called at startup
+// and on ScreenSaverNotify.
+static bool dpms_monitor_off(xcb_connection_t *c, const idle_state_t *idle) {
+  if (!idle->have_dpms) return false;
+  xcb_dpms_info_reply_t *rp = xcb_dpms_info_reply(c, xcb_dpms_info(c), NULL);
+  bool off = rp && rp->state && rp->power_level != XCB_DPMS_DPMS_MODE_ON;
+  free(rp);
+  return off;
+}
+
+static void backbuf_destroy(backbuf_t *bb, xcb_connection_t *c) {
+#ifdef HAVE_CAIRO
+  if (bb->cr) cairo_destroy(bb->cr);
+  if (bb->surface) cairo_surface_destroy(bb->surface);
+  if (bb->picture) xcb_render_free_picture(c, bb->picture);
+  bb->cr = NULL;
+  bb->surface = NULL;
+  bb->picture = 0;
+#endif
+  if (bb->pixmap) xcb_free_pixmap(c, bb->pixmap);
+  bb->pixmap = 0;
+  bb->w = bb->h = 0;
+}
+
+// Whether the back buffer can be drawn into.
+static bool backbuf_ready(const backbuf_t *bb) {
+#ifdef HAVE_CAIRO
+  if (!bb->pixmap_only) return bb->cr != NULL;
+#endif
+  return bb->pixmap != 0;
+}
+
+// Makes sure the back buffer matches w x h. Returns true if it was
+// (re)created, in which case its contents are undefined.
+static bool backbuf_ensure(backbuf_t *bb, xcb_connection_t *c, xcb_screen_t *screen,
+                           xcb_window_t win, xcb_visualtype_t *visual, uint16_t w, uint16_t h) {
+  if (backbuf_ready(bb) && bb->w == w && bb->h == h) return false;
+  backbuf_destroy(bb, c);
+  if (!bb->use_shm) {
+    bb->pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, screen->root_depth, bb->pixmap, win, w, h);
+  }
+#ifdef HAVE_CAIRO
+  if (bb->use_shm) {
+    int stride = cairo_format_stride_for_width(bb->shm_format, w);
+    if (!shmbuf_reserve(&bb->shm, c, (size_t)stride * h)) return false;
+    // A reused segment may still be read by the last put.
+    shmbuf_wait(&bb->shm, c);
+    bb->surface = cairo_image_surface_create_for_data(bb->shm.addr, bb->shm_format, w, h, stride);
+  } else if (!bb->pixmap_only) {
+    bb->surface = cairo_xcb_surface_create(c, bb->pixmap, visual, w, h);
+  }
+  if (bb->pict_format && bb->pixmap) {
+    bb->picture = xcb_generate_id(c);
+    xcb_render_create_picture(c, bb->picture, bb->pixmap, bb->pict_format, 0, NULL);
+  }
+  if (bb->surface) bb->cr = cairo_create(bb->surface);
+#else
+  (void)visual;
+#endif
+  bb->w = w;
+  bb->h = h;
+  return true;
+}
+
+// Copies the x/y/w/h rectangle of the back buffer to the same place in win.
+static void backbuf_present(backbuf_t *bb, xcb_connection_t *c, xcb_window_t win, xcb_gcontext_t gc,
+                            uint8_t depth, int16_t x, int16_t y, uint16_t w, uint16_t h) {
+#ifdef HAVE_CAIRO
+  if (bb->use_shm) {
+    shmbuf_put(&bb->shm, c, win, gc, depth, bb->w, bb->h, x, y, w, h);
+    return;
+  }
+#else
+  (void)depth;
+#endif
+  xcb_copy_area(c, bb->pixmap, win, gc, x, y, x, y, w, h);
+}
+
+static void painter_layout(painter_t *p, const char *s, const frame_t *prev, frame_t *out) {
+#ifdef HAVE_CAIRO
+  if (!p->bitmap) {
+    render_layout(&p->render, s, prev, out);
+    return;
+  }
+#endif
+  (void)prev;
+  bitmap_layout(&p->bm, s, out);
+}
+
+static bool painter_damage(const painter_t *p, const frame_t *prev, const frame_t *f, bool force_full,
+                           damage_t *d) {
+#ifdef HAVE_CAIRO
+  if (!p->bitmap) return render_damage(&p->render, prev, f, force_full, d);
+#endif
+  return bitmap_damage(&p->bm, prev, f, force_full, d);
+}
+
+// Draws the damaged span of f into bb. The bitmap font sends it straight to
+// the pixmap; cairo output is flushed so the following copy sees it.
+static void painter_paint(painter_t *p, xcb_connection_t *c, xcb_gcontext_t gc, backbuf_t *bb,
+                          const frame_t *f, const damage_t *d) {
+#ifdef HAVE_CAIRO
+  if (!p->bitmap) {
+    render_paint(&p->render, bb->cr, f, d);
+    cairo_surface_flush(bb->surface);
+    return;
+  }
+#endif
+  if (!bitmap_paint(&p->bm, c, bb->pixmap, gc, f, d)) {
+    fprintf(stderr, "Out of memory drawing a %ux%u frame\n", f->w, f->h);
+  }
+}
+
+static void painter_destroy(painter_t *p) {
+#ifdef HAVE_CAIRO
+  if (!p->bitmap) render_destroy(&p->render);
+#endif
+  bitmap_destroy(&p->bm);
+}
+
+// Sends a ConfigureWindow carrying only the fields that differ from the
+// cached geometry (plus a restack if one is pending). Returns true if a
+// request was sent.
+static bool apply_geometry(xcb_connection_t *c, xcb_window_t win, geometry_t *g,
+                           int16_t x, int16_t y, uint16_t w, uint16_t h) {
+  uint32_t cfg[5];
+  uint16_t mask = 0;
+  int cidx = 0;
+  if (x != g->x) { mask |= XCB_CONFIG_WINDOW_X;      cfg[cidx++] = (uint32_t)x; }
+  if (y != g->y) { mask |= XCB_CONFIG_WINDOW_Y;      cfg[cidx++] = (uint32_t)y; }
+  if (w != g->w) { mask |= XCB_CONFIG_WINDOW_WIDTH;  cfg[cidx++] = (uint32_t)w; }
+  if (h != g->h) { mask |= XCB_CONFIG_WINDOW_HEIGHT; cfg[cidx++] = (uint32_t)h; }
+  if (g->raise_pending) {
+    mask |= XCB_CONFIG_WINDOW_STACK_MODE; cfg[cidx++] = XCB_STACK_MODE_ABOVE;
+    g->raise_pending = false;
+  }
+  if (!mask) return false;
+  xcb_configure_window(c, win, mask, cfg);
+  g->x = x; g->y = y; g->w = w; g->h = h;
+  return true;
+}
+
+// Draws the cells of cur whose text changed into the flash layer's back
+// buffer, with the inverted colors. Returns whether anything was painted
+// (*d then holds the span).
+static bool flash_layer_paint(flash_layer_t *l, xcb_connection_t *c, xcb_screen_t *screen,
+                              xcb_visualtype_t *visual, xcb_gcontext_t gc, bool force_full, painter_t *painter,
+                              const frame_t *cur, const colors_t *inverted, damage_t *d) {
+  frame_t f = *cur;
+  f.colors = *inverted;
+  bool resized = backbuf_ensure(&l->bb, c, screen, screen->root, visual, f.w, f.h);
+  if (!backbuf_ready(&l->bb)) return false;
+  bool painted = painter_damage(painter, &l->last, &f, resized || force_full, d);
+  if (painted) painter_paint(painter, c, gc, &l->bb, &f, d);
+  l->last = f;
+  return painted;
+}
+
+// Brings one overlay's layer window in line with the shared layer: opacity
+// (only when it changed), the overlay's geometry and restacks, and the
+// painted span d (NULL if nothing was painted). An opacity of 0 means the
+// flash is over and the layer is unmapped.
+static void overlay_layer_update(overlay_t *ov, xcb_connection_t *c, xcb_gcontext_t gc, uint8_t depth,
+                                 xcb_atom_t opacity_atom, flash_layer_t *l, uint32_t opacity,
+                                 bool opacity_changed, const damage_t *d) {
+  if (!ov->layer_win) return;
+  if (!opacity) {
+    if (ov->layer_mapped) {
+      xcb_unmap_window(c, ov->layer_win);
+      ov->layer_mapped = false;
+    }
+    return;
+  }
+  if (opacity_changed || !ov->layer_mapped) {
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, ov->layer_win, opacity_atom, XCB_ATOM_CARDINAL, 32, 1, &opacity);
+  }
+  ov->layer_geom.raise_pending = ov->raised && ov->layer_mapped;
+  apply_geometry(c, ov->layer_win, &ov->layer_geom, ov->geom.x, ov->geom.y, l->bb.w, l->bb.h);
+  if (!ov->layer_mapped) {
+    // Mapping puts it on top of its siblings, right above the overlay; the
+    // contents follow with the Expose.
+    xcb_map_window(c, ov->layer_win);
+    ov->layer_mapped = true;
+  } else if (ov->layer_present_all) {
+    backbuf_present(&l->bb, c, ov->layer_win, gc, depth, 0, 0, l->bb.w, l->bb.h);
+  } else if (d) {
+    backbuf_present(&l->bb, c, ov->layer_win, gc, depth, d->x0, 0, d->x1 - d->x0, l->bb.h);
+  }
+  ov->layer_present_all = false;
+}
+
+// Top-right anchor of a w-wide overlay inside its area.
+static int16_t overlay_anchor_x(const overlay_t *ov, uint16_t w, uint32_t margin) {
+  return (int16_t)((int)ov->area_x + (int)ov->area_w - (int)w - (int)margin);
+}
+
+// Where a w-wide frame goes. Recomputed only when the area (root resize,
+// RandR change) or the frame width changed; otherwise the cached position.
+static void overlay_place(overlay_t *ov, uint16_t w, uint32_t margin, int16_t *x, int16_t *y) {
+  if (ov->place_dirty || ov->placed_w != w) {
+    ov->place_x = overlay_anchor_x(ov, w, margin);
+    ov->place_y = (int16_t)(ov->area_y + (int)margin);
+    ov->placed_w = w;
+    ov->place_dirty = false;
+  }
+  *x = ov->place_x;
+  *y = ov->place_y;
+}
+
+static void overlay_create_layer(overlay_t *ov, xcb_connection_t *c, xcb_screen_t *screen,
+                                 const xcb_atom_t atoms[ATOM_COUNT]) {
+  const geometry_t *g = &ov->geom;
+  ov->layer_win = create_overlay_window(c, screen, g->x, g->y, g->w, g->h, XCB_EVENT_MASK_EXPOSURE, atoms);
+  ov->layer_geom = (geometry_t){ .x = g->x, .y = g->y, .w = g->w, .h = g->h };
+}
+
+// Creates, maps and raises the window of an overlay whose area is set, plus
+// its (unmapped) flash layer window when with_layer.
+static void overlay_create(overlay_t *ov, xcb_connection_t *c, xcb_screen_t *screen,
+                           const xcb_atom_t atoms[ATOM_COUNT], uint32_t margin,
+                           uint16_t w, uint16_t h, bool with_layer) {
+  int16_t x = overlay_anchor_x(ov, w, margin);
+  int16_t y = (int16_t)(ov->area_y + (int)margin);
+  ov->win = create_overlay_window(
+    c, screen, x, y, w, h,
+    XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_VISIBILITY_CHANGE,
+    atoms);
+  // Geometry as created; the map-time raise leaves nothing pending.
+  ov->geom = (geometry_t){ .x = x, .y = y, .w = w, .h = h };
+  ov->present_all = true;
+  ov->exposed = (rect_t){0};
+  if (with_layer) overlay_create_layer(ov, c, screen, atoms);
+
+  // Map and raise
+  xcb_map_window(c, ov->win);
+  uint32_t cfg_vals[1] = { XCB_STACK_MODE_ABOVE };
+  xcb_configure_window(c, ov->win, XCB_CONFIG_WINDOW_STACK_MODE, cfg_vals);
+}
+
+static void overlay_destroy(overlay_t *ov, xcb_connection_t *c) {
+  if (ov->layer_win) xcb_destroy_window(c, ov->layer_win);
+  xcb_destroy_window(c, ov->win);
+  memset(ov, 0, sizeof(*ov));
+}
+
+// Overlay owning window (its own or its flash layer's), or NULL.
+static overlay_t *overlay_find(overlay_t *ovs, size_t n, xcb_window_t win) {
+  for (size_t i = 0; i < n; ++i) {
+    if (ovs[i].win == win || (ovs[i].layer_win && ovs[i].layer_win == win)) return &ovs[i];
+  }
+  return NULL;
+}
+
+// Makes the overlays match areas, keyed by CRTC: gone ones are destroyed,
+// new ones created and the rest re-anchored on their next geometry update.
+static void overlays_sync(overlay_t *ovs, size_t *n, const output_area_t *areas, size_t n_areas,
+                          xcb_connection_t *c, xcb_screen_t *screen, const xcb_atom_t atoms[ATOM_COUNT],
+                          const options_t *opt, uint16_t w, uint16_t h, bool with_layer) {
+  for (size_t i = 0; i < *n; ) {
+    bool keep = false;
+    for (size_t k = 0; k < n_areas; ++k) keep |= areas[k].crtc == ovs[i].crtc;
+    if (keep) {
+      ++i;
+      continue;
+    }
+    if (opt->debug) fprintf(stderr, "[debug] output removed: crtc=0x%x\n", ovs[i].crtc);
+    overlay_destroy(&ovs[i], c);
+    ovs[i] = ovs[*n - 1];
+    --*n;
+  }
+  for (size_t k = 0; k < n_areas; ++k) {
+    const output_area_t *a = &areas[k];
+    overlay_t *ov = NULL;
+    for (size_t i = 0; i < *n; ++i) {
+      if (ovs[i].crtc == a->crtc) ov = &ovs[i];
+    }
+    bool fresh = !ov;
+    if (fresh) {
+      if (*n >= OUTPUTS_MAX) continue;
+      ov = &ovs[(*n)++];
+      memset(ov, 0, sizeof(*ov));
+      ov->crtc = a->crtc;
+    }
+    if (ov->area_x != a->x || ov->area_y != a->y || ov->area_w != a->w || ov->area_h != a->h) {
+      ov->area_x = a->x; ov->area_y = a->y;
+      ov->area_w = a->w; ov->area_h = a->h;
+      ov->place_dirty = true;
+    }
+    if (fresh) overlay_create(ov, c, screen, atoms, opt->margin_px, w, h, with_layer);
+    if (opt->debug) {
+      fprintf(stderr, "[debug] output %s: %s crtc=0x%x %ux%u+%d+%d\n", a->name, fresh ? "added" : "kept",
+              a->crtc, a->w, a->h, a->x, a->y);
+    }
+  }
+}
+
+// One X display: its connection and everything created on it. The clock
+// string, flash state, timers and the loaded font are shared by every
+// display of the process (--displays, --display-dir); a display only adds
+// its windows, back buffers and server-side atlas.
+typedef struct {
+  char name[DISPLAY_NAME_MAX];  // as given; empty for $DISPLAY
+  xcb_connection_t *c;
+  xcb_screen_t *screen;
+  xcb_visualtype_t *visual;
+  xcb_atom_t atoms[ATOM_COUNT];
+  painter_t painter;
+  bool fonts_ready;           // the painter can draw
+  overlay_t ovs[OUTPUTS_MAX];
+  size_t n_ov;
+  outputs_t outs;
+  bool outputs_dirty;
+  uint16_t root_w, root_h;    // follows the root's ConfigureNotify
+  flash_layer_t layer;
+  idle_state_t idle;
+  backbuf_t bb;
+  backbuf_t spare;            // --render-ahead target
+  bool ahead;                 // renders ahead (not with shm)
+  bool held;                  // cur is painted ahead, presented at its boundary
+#ifdef HAVE_CAIRO
+  linemask_t lm;
+  bool use_linemask;
+#endif
+  vsync_t vs;
+  xcb_gcontext_t gc;          // presents the back buffer
+  bool need_redraw;
+  bool readable;              // epoll reported the connection readable
+  uint32_t last_marker_seq;   // sequence of the previous tick's NoOperation marker
+  uint32_t round_trips;       // replies waited for since the last tick (--stats)
+  uint32_t events;            // X events handled since the last tick (--stats)
+  // Previous frame, for damage tracking: when only some characters changed
+  // (usually the seconds digits) just their cells are repainted.
+  frame_t last;
+  // The frame being drawn, from painting to presenting.
+  bool in_frame;
+  frame_t cur;
+  damage_t dmg;
+  bool painted;
+  backbuf_t *target;
+} display_t;
+
+#define DISPLAYS_MAX 256
+#define DISPLAYDIR_RETRY_MS 2000  // retry a socket whose server did not answer
+#define DISPLAYDIR_RETRIES 5      // ...this many times per directory change
+
+// What all displays share: the options, the font and how frames are paced.
+typedef struct {
+  const options_t *opt;
+  int64_t t0_ns;
+  bool fonts_loaded;  // the shared font (and atlas source) is ready
+#ifdef HAVE_CAIRO
+  render_t master;    // loaded once; each display gets a render_share() copy
+  render_t pending;   // a font (or alphabet) change being loaded
+  bool reloading;     // fl loads into pending rather than master
+  fontload_t fl;
+#endif
+  bool want_vsync;    // a sub-second plan with --precision
+  bool paced;         // vblanks (Present) pace the sub-second digits
+  bool ahead_on;      // --render-ahead applies to this format
+  int64_t lead_ns;
+  const status_t *status;  // segments after the clock (their atlas characters)
+} shared_t;
+
+static const char *display_label(const display_t *d) {
+  return d->name[0] ? d->name : "$DISPLAY";
+}
+
+// Gives d its copy of the shared font and uploads the atlas to where d's
+// frames are drawn: server side for the xcb and xrender backends, client
+// memory for shm.
+static void display_fonts_ready(shared_t *sh, display_t *d) {
+#ifdef HAVE_CAIRO
+  if (!d->painter.bitmap) {
+    cairo_surface_t *like = d->bb.use_shm
+      ? cairo_image_surface_create(d->bb.shm_format, 1, 1)
+      : cairo_xcb_surface_create(d->c, d->screen->root, d->visual, 1, 1);
+    render_t *render = &d->painter.render;
+    if (!render_share(render, &sh->master, like)) {
+      fprintf(stderr, "Failed to create glyph atlas, falling back to text rendering\n");
+    } else if (sh->opt->debug) {
+      fprintf(stderr, "[debug] %s: glyph atlas: %zu cells of %dx%d\n", display_label(d),
+              strlen(render->alphabet), render->atlas.cell_w, render->atlas.cell_h);
+    }
+    cairo_surface_destroy(like);
+    startup_mark(sh->opt, sh->t0_ns, "glyph atlas");
+  }
+#else
+  (void)sh;
+#endif
+  d->fonts_ready = true;
+  d->need_redraw = true;
+}
+
+// Makes d lay out and repaint its next frame from scratch, after the
+// layout metrics changed under it.
+static void display_invalidate(display_t *d) {
+  d->held = false;  // a frame painted ahead used the old state
+  memset(&d->last, 0, sizeof(d->last));
+  memset(&d->layer.last, 0, sizeof(d->layer.last));
+  d->need_redraw = true;
+}
+
+#ifdef HAVE_CAIRO
+// Takes over the font loaded by the worker: at startup into the master, or
+// after a font or alphabet change into pending, which then replaces the
+// master. Returns false if the font could not be loaded.
+static bool shared_fonts_ready(shared_t *sh) {
+  const options_t *opt = sh->opt;
+  bool reload = sh->reloading;
+  sh->reloading = false;
+  render_t *render = reload ? &sh->pending : &sh->master;
+  if (!fontload_finish(&sh->fl)) {
+    fprintf(stderr, "Failed to load font \"%s\"\n", sh->fl.opt.font_family);
+    if (reload) render_destroy(render);
+    return false;
+  }
+  if (opt->debug) {
+    const font_cache_t *font = &render->font;
+    if (opt->atlas_cache) {
+      fprintf(stderr, "[debug] atlas cache %s: %s\n", render->cache.hit ? "hit" : "miss",
+              render->cache.path[0] ? render->cache.path : "(no cache directory)");
+    }
+    fprintf(stderr, "[debug] font: ascent=%.2f descent=%.2f monospace=%d advance=%.2f\n",
+            font->fe.ascent, font->fe.descent, font->monospace, font->mono_advance);
+    if (render->mono.enabled)
+      fprintf(stderr, "[debug] mono layout: x_bearing=%.0f height=%u\n",
+              render->mono.x_bearing, render->mono.h);
+  }
+  if (!sh->fl.atlas_ok) fprintf(stderr, "Failed to rasterize the glyph atlas\n");
+  if (reload) {
+    render_destroy(&sh->master);
+    sh->master = *render;
+    memset(render, 0, sizeof(*render));
+  } else {
+    startup_mark(opt, sh->t0_ns, "font load");
+  }
+  sh->fonts_loaded = true;
+  return true;
+}
+#endif
+
+static void display_close(display_t *d) {
+  xcb_connection_t *c = d->c;
+  for (size_t i = 0; i < d->n_ov; ++i) overlay_destroy(&d->ovs[i], c);
+#ifdef HAVE_CAIRO
+  linemask_destroy(&d->lm, c);
+  shmbuf_destroy(&d->bb.shm, c);
+#endif
+  backbuf_destroy(&d->layer.bb, c);
+  backbuf_destroy(&d->spare, c);
+  backbuf_destroy(&d->bb, c);
+  if (d->gc) xcb_free_gc(c, d->gc);
+  painter_destroy(&d->painter);
+  xcb_disconnect(c);
+  free(d);
+}
+
+// Connects to display name (NULL or empty: $DISPLAY) and creates, maps and
+// prepares everything the overlay needs there. Prints the problem and
+// returns NULL on failure.
+static display_t *display_open(shared_t *sh, const char *name) {
+  const options_t *opt = sh->opt;
+  const int64_t t0_ns = sh->t0_ns;
+  display_t *d = calloc(1, sizeof(*d));
+  if (!d) return NULL;
+  if (name) snprintf(d->name, sizeof(d->name), "%s", name);
+
+  int screen_num = 0;
+  xcb_connection_t *cconn = xcb_connect(d->name[0] ? d->name : NULL, &screen_num);
+  if (!cconn || xcb_connection_has_error(cconn)) {
+    fprintf(stderr, "Failed to connect to X server%s%s\n", d->name[0] ? " " : "", d->name);
+    if (cconn) xcb_disconnect(cconn);
+    free(d);
+    return NULL;
+  }
+  d->c = cconn;
+  startup_mark(opt, t0_ns, "connect");
+
+  // Pipeline every startup round trip: atoms, the extensions we (and cairo)
+  // use and BIG-REQUESTS all go out in one flush, and the replies are
+  // collected only when needed, while the font loads on its thread.
+  xcb_intern_atom_cookie_t atom_cookies[ATOM_COUNT];
+  intern_atoms_send(cconn, atom_cookies);
+  xcb_intern_atom_cookie_t cm_cookie_atom = {0};
+  if (opt->flash_mode == FLASH_MODE_COMPOSITOR) {
+    char cm_name[32];
+    snprintf(cm_name, sizeof(cm_name), "_NET_WM_CM_S%d", screen_num);
+    cm_cookie_atom = xcb_intern_atom(cconn, 0, (uint16_t)strlen(cm_name), cm_name);
+  }
+  xcb_prefetch_extension_data(cconn, &xcb_shape_id);
+  xcb_prefetch_extension_data(cconn, &xcb_screensaver_id);
+  xcb_prefetch_extension_data(cconn, &xcb_dpms_id);
+  if (opt->outputs) xcb_prefetch_extension_data(cconn, &xcb_randr_id);
+  if (sh->want_vsync) xcb_prefetch_extension_data(cconn, &xcb_present_id);
+#ifdef HAVE_CAIRO
+  if (opt->backend != BACKEND_BITMAP) xcb_prefetch_extension_data(cconn, &xcb_render_id);
+  if (opt->backend == BACKEND_SHM) xcb_prefetch_extension_data(cconn, &xcb_shm_id);
+  xcb_render_query_pict_formats_cookie_t formats_cookie = {0};
+  if (opt->backend == BACKEND_XRENDER) formats_cookie = xcb_render_query_pict_formats(cconn);
+#endif
+  xcb_prefetch_maximum_request_length(cconn);
+  xcb_flush(cconn);
+
+  const xcb_setup_t *setup = xcb_get_setup(cconn);
+  xcb_screen_iterator_t iter = xcb_setup_roots_iterator(setup);
+  for (int s = 0; s < screen_num; ++s) xcb_screen_next(&iter);
+  xcb_screen_t *screen = iter.data;
+  if (!screen) {
+    fprintf(stderr, "Could not get default screen\n");
+    display_close(d);
+    return NULL;
+  }
+  d->screen = screen;
+  if (opt->debug) {
+    fprintf(stderr, "[debug] %s: screen: %ux%u, screen_num=%d\n", display_label(d),
+            screen->width_in_pixels, screen->height_in_pixels, screen_num);
+  }
+
+  xcb_visualtype_t *visual = get_visualtype_for_screen(setup, screen);
+  if (!visual) {
+    fprintf(stderr, "Could not find visual for screen\n");
+    display_close(d);
+    return NULL;
+  }
+  d->visual = visual;
+  startup_mark(opt, t0_ns, "visual lookup");
+
+  painter_t *painter = &d->painter;
+  painter->bitmap = opt->backend == BACKEND_BITMAP;
+  if (painter->bitmap) {
+    if (!bitmap_init(&painter->bm, opt, cconn, screen, visual)) {
+      display_close(d);
+      return NULL;
+    }
+    if (opt->debug) {
+      fprintf(stderr, "[debug] bitmap font: scale=%d cell=%dx%d bpp=%u\n",
+              painter->bm.scale, painter->bm.cell_w, painter->bm.cell_h, painter->bm.bytes_pp * 8u);
+    }
+    startup_mark(opt, t0_ns, "font load");
+  }
+
+  xcb_atom_t *atoms = d->atoms;
+  intern_atoms_collect(cconn, atom_cookies, atoms);
+  xcb_atom_t cm_atom = XCB_ATOM_NONE;
+  if (opt->flash_mode == FLASH_MODE_COMPOSITOR) {
+    xcb_intern_atom_reply_t *rp = xcb_intern_atom_reply(cconn, cm_cookie_atom, NULL);
+    if (rp) cm_atom = rp->atom;
+    free(rp);
+  }
+  startup_mark(opt, t0_ns, "atoms");
+
+  // Overlays: one anchored to the whole root, or one per selected monitor.
+  // Initial tiny size; will be resized after measuring text.
+  uint16_t w = 64, h = 24;
+  if (opt->outputs && !outputs_init(&d->outs, cconn, screen->root)) {
+    fprintf(stderr, "RandR 1.3 unavailable, showing one overlay for the whole screen\n");
+  }
+  if (d->outs.present) {
+    output_area_t areas[OUTPUTS_MAX];
+    size_t n_areas = outputs_query(&d->outs, cconn, screen->root, opt->outputs, areas);
+    if (n_areas == 0) fprintf(stderr, "No active output matches --outputs %s\n", opt->outputs);
+    overlays_sync(d->ovs, &d->n_ov, areas, n_areas, cconn, screen, atoms, opt, w, h, false);
+  } else {
+    d->ovs[0].area_w = screen->width_in_pixels;
+    d->ovs[0].area_h = screen->height_in_pixels;
+    overlay_create(&d->ovs[0], cconn, screen, atoms, opt->margin_px, w, h, false);
+    d->n_ov = 1;
+  }
+  if (opt->debug) {
+    for (size_t i = 0; i < d->n_ov; ++i) fprintf(stderr, "[debug] created window id=0x%08x\n", d->ovs[i].win);
+  }
+  // The setup's screen size goes stale when the root is resized (xrandr);
+  // follow the root's ConfigureNotify instead.
+  d->root_w = screen->width_in_pixels;
+  d->root_h = screen->height_in_pixels;
+  uint32_t root_mask = XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+  xcb_change_window_attributes(cconn, screen->root, XCB_CW_EVENT_MASK, &root_mask);
+
+  // Compositor-driven flash: only worth it if a compositor owns _NET_WM_CM_Sn.
+  d->layer.bb.pixmap_only = painter->bitmap;
+  xcb_get_selection_owner_cookie_t cm_cookie = {0};
+  bool want_layer = opt->flash_mode == FLASH_MODE_COMPOSITOR && opt->flash_minutes > 0 &&
+                    cm_atom != XCB_ATOM_NONE && atoms[ATOM_NET_WM_WINDOW_OPACITY] != XCB_ATOM_NONE;
+  if (want_layer) cm_cookie = xcb_get_selection_owner(cconn, cm_atom);
+
+  // Screen saver and DPMS state, so an invisible overlay does not tick.
+  idle_state_t *idle = &d->idle;
+  xcb_screensaver_query_info_cookie_t saver_cookie = {0};
+  const xcb_query_extension_reply_t *ext = xcb_get_extension_data(cconn, &xcb_screensaver_id);
+  if (ext && ext->present) {
+    idle->saver_event = ext->first_event;
+    xcb_screensaver_select_input(cconn, screen->root, XCB_SCREENSAVER_EVENT_NOTIFY_MASK);
+    saver_cookie = xcb_screensaver_query_info(cconn, screen->root);
+  }
+  ext = xcb_get_extension_data(cconn, &xcb_dpms_id);
+  idle->have_dpms = ext && ext->present;
+
+  xcb_flush(cconn);
+  startup_mark(opt, t0_ns, "window mapped");
+
+  // MIT-SHM back buffer: needs the extension, a directly drawable pixel
+  // layout and a server on this host (the attach fails on remote ones).
+  backbuf_t *bb = &d->bb;
+  bb->pixmap_only = painter->bitmap;
+#ifdef HAVE_CAIRO
+  if (opt->backend == BACKEND_SHM) {
+    bb->use_shm = shmbuf_probe(&bb->shm, cconn, screen, visual, &bb->shm_format) &&
+                  shmbuf_reserve(&bb->shm, cconn, (size_t)w * h * 4);
+    if (!bb->use_shm) {
+      fprintf(stderr, "MIT-SHM unavailable (missing, remote or unsupported visual), using xcb backend\n");
+    } else if (opt->debug) {
+      fprintf(stderr, "[debug] backend: shm segment of %zu bytes\n", bb->shm.size);
+    }
+  }
+
+  // XRender line mask: needs an A8 format and one for the window visual.
+  if (opt->backend == BACKEND_XRENDER) {
+    xcb_render_query_pict_formats_reply_t *fr = xcb_render_query_pict_formats_reply(cconn, formats_cookie, NULL);
+    d->use_linemask = fr && linemask_init(&d->lm, fr, screen->root_visual);
+    free(fr);
+    if (!d->use_linemask) {
+      fprintf(stderr, "XRender formats unavailable, using xcb backend\n");
+    }
+    // Each back buffer keeps its picture, so a spare swapped in by
+    // --render-ahead needs no new one.
+    if (d->use_linemask) bb->pict_format = d->spare.pict_format = d->lm.dst_format;
+  }
+#endif
+
+  if (idle->saver_event) {
+    xcb_screensaver_query_info_reply_t *si = xcb_screensaver_query_info_reply(cconn, saver_cookie, NULL);
+    idle->saver_active = si && si->state == XCB_SCREENSAVER_STATE_ON;
+    free(si);
+  }
+  idle->dpms_off = dpms_monitor_off(cconn, idle);
+  if (opt->debug) {
+    fprintf(stderr, "[debug] idle: screensaver=%s(%d) dpms=%s(%d)\n",
+            idle->saver_event ? "yes" : "no", idle->saver_active,
+            idle->have_dpms ? "yes" : "no", idle->dpms_off);
+  }
+
+  if (want_layer) {
+    xcb_get_selection_owner_reply_t *owner = xcb_get_selection_owner_reply(cconn, cm_cookie, NULL);
+    d->layer.enabled = owner && owner->owner != XCB_WINDOW_NONE;
+    free(owner);
+    if (!d->layer.enabled) {
+      fprintf(stderr, "No compositor running, using client-side flash fade\n");
+    }
+    for (size_t i = 0; d->layer.enabled && i < d->n_ov; ++i) {
+      overlay_create_layer(&d->ovs[i], cconn, screen, atoms);
+      if (opt->debug) fprintf(stderr, "[debug] flash layer window id=0x%08x\n", d->ovs[i].layer_win);
+    }
+  }
+
+  if (sh->want_vsync) vsync_init(&d->vs, cconn);
+
+  // --render-ahead: a tick's frame is painted into a spare pixmap lead_ns
+  // before its boundary; at the boundary it is copied out and becomes the
+  // back buffer. Client-side (shm) frames have no slack worth using.
+  d->spare.pixmap_only = painter->bitmap;
+  d->ahead = sh->ahead_on && !bb->use_shm;
+  if (sh->ahead_on && !d->ahead) {
+    fprintf(stderr, "--render-ahead needs the xcb or xrender backend; painting at the boundary\n");
+  }
+
+  d->gc = xcb_generate_id(cconn);
+  uint32_t gc_vals[1] = { 0 }; // no GraphicsExpose/NoExpose events for copies
+  xcb_create_gc(cconn, d->gc, screen->root, XCB_GC_GRAPHICS_EXPOSURES, gc_vals);
+
+  if (painter->bitmap || sh->fonts_loaded) display_fonts_ready(sh, d);
+  return d;
 }
 
-static long ms_to_next_second(void) {
-  struct timespec ts;
-  clock_gettime(CLOCK_REALTIME, &ts);
-  long ms = ts.tv_nsec / 1000000L;
-  long rem = 1000L - (ms % 1000L);
-  return (rem == 1000L) ? 0L : rem;
+// Drains d's events; with readable, also reads what arrived on its socket
+// (otherwise only events already queued by reply waits). Returns false if
+// the connection was lost.
+static bool display_events(display_t *d, const options_t *opt, bool paced, bool readable) {
+  xcb_connection_t *cconn = d->c;
+  xcb_generic_event_t *ev;
+  while ((ev = readable ? xcb_poll_for_event(cconn) : xcb_poll_for_queued_event(cconn)) != NULL) {
+    d->events++;
+#ifdef HAVE_CAIRO
+    if (d->bb.use_shm && shmbuf_handle_event(&d->bb.shm, ev)) {
+      free(ev);
+      continue;
+    }
+#endif
+    bool vblank;
+    if (paced && vsync_handle_event(&d->vs, ev, &vblank)) {
+      d->need_redraw |= vblank;
+      free(ev);
+      continue;
+    }
+    uint8_t rt = ev->response_type & ~0x80;
+    if (opt->debug) {
+      fprintf(stderr, "[debug] event: %s (%u)\n", event_name(rt), rt);
+    }
+    // Only what changes our windows asks for a frame. Exposes of one drain
+    // add up to a single rectangle per window, copied once from the back
+    // buffer; nothing is repainted for them.
+    if (rt == XCB_EXPOSE) {
+      // Window contents were lost; the back buffer still has them.
+      xcb_expose_event_t *ee = (xcb_expose_event_t *)ev;
+      overlay_t *ov = overlay_find(d->ovs, d->n_ov, ee->window);
+      if (ov && ee->window == ov->layer_win) {
+        ov->layer_present_all = true;
+        d->need_redraw = true;
+      } else if (ov) {
+        rect_union(&ov->exposed, ee->x, ee->y, ee->x + ee->width, ee->y + ee->height);
+        d->need_redraw = true;
+        if (opt->debug && ee->count == 0) {
+          fprintf(stderr, "[debug] exposed 0x%08x: [%d,%d)x[%d,%d)\n", ov->win, ov->exposed.x0,
+                  ov->exposed.x1, ov->exposed.y0, ov->exposed.y1);
+        }
+      }
+    } else if (rt == XCB_VISIBILITY_NOTIFY) {
+      xcb_visibility_notify_event_t *ve = (xcb_visibility_notify_event_t *)ev;
+      overlay_t *ov = overlay_find(d->ovs, d->n_ov, ve->window);
+      // Being covered by our own flash layer is nothing to raise or
+      // suspend for.
+      if (ov && ve->window == ov->win && !ov->layer_mapped) {
+        bool obscured = ve->state != XCB_VISIBILITY_UNOBSCURED;
+        // Raise once per transition into being covered; if whatever covers
+        // us raises itself again we do not fight it every tick.
+        if (obscured && !ov->geom.obscured) {
+          ov->geom.raise_pending = true;
+          d->need_redraw = true;  // the frame's configure restacks
+        }
+        ov->geom.obscured = obscured;
+        ov->fully_obscured = ve->state == XCB_VISIBILITY_FULLY_OBSCURED;
+      }
+    } else if (rt == XCB_CONFIGURE_NOTIFY) {
+      xcb_configure_notify_event_t *ce = (xcb_configure_notify_event_t *)ev;
+      overlay_t *ov = overlay_find(d->ovs, d->n_ov, ce->window);
+      if (ce->window == d->screen->root && (ce->width != d->root_w || ce->height != d->root_h)) {
+        if (opt->debug) fprintf(stderr, "[debug] root resized to %ux%u\n", ce->width, ce->height);
+        d->root_w = ce->width;
+        d->root_h = ce->height;
+        d->need_redraw = true;
+        if (d->outs.present) {
+          d->outputs_dirty = true;  // monitors moved too; RandR has the details
+        } else if (d->n_ov) {
+          d->ovs[0].area_w = ce->width;
+          d->ovs[0].area_h = ce->height;
+          d->ovs[0].place_dirty = true;
+        }
+      } else if (ov && ce->window == ov->win) {
+        // Track what the server actually has, so anything that moved or
+        // resized us gets corrected by a frame. The echo of our own
+        // ConfigureWindow (or a restack) matches the cache and is ignored.
+        geometry_t *g = &ov->geom;
+        if (g->x != ce->x || g->y != ce->y || g->w != ce->width || g->h != ce->height) {
+          g->x = ce->x; g->y = ce->y;
+          g->w = ce->width; g->h = ce->height;
+          d->need_redraw = true;
+        }
+      }
+    } else if (d->idle.saver_event && rt == d->idle.saver_event + XCB_SCREENSAVER_NOTIFY) {
+      xcb_screensaver_notify_event_t *se = (xcb_screensaver_notify_event_t *)ev;
+      d->idle.saver_active = se->state == XCB_SCREENSAVER_STATE_ON;
+      d->idle.dpms_off = dpms_monitor_off(cconn, &d->idle);
+      d->round_trips += d->idle.have_dpms;
+      if (opt->debug) {
+        fprintf(stderr, "[debug] screensaver %s, dpms %s\n",
+                d->idle.saver_active ? "on" : "off", d->idle.dpms_off ? "off" : "on");
+      }
+    } else if (outputs_is_change(&d->outs, ev)) {
+      d->outputs_dirty = true;
+    }
+    free(ev);
+  }
+  if (xcb_connection_has_error(cconn)) return false;
+
+  // Monitors came, went or moved: a burst of RandR events is one re-query.
+  if (d->outputs_dirty) {
+    output_area_t areas[OUTPUTS_MAX];
+    size_t n_areas = outputs_query(&d->outs, cconn, d->screen->root, opt->outputs, areas);
+    d->round_trips += OUTPUTS_QUERY_ROUND_TRIPS;
+    overlays_sync(d->ovs, &d->n_ov, areas, n_areas, cconn, d->screen, d->atoms, opt,
+                  d->last.w ? d->last.w : 64, d->last.h ? d->last.h : 24, d->layer.enabled);
+    d->outputs_dirty = false;
+    d->need_redraw = true;
+  }
+  return true;
+}
+
+// Suspends d while nobody can see it (its frames are skipped) and resumes it
+// with a full repaint. Returns whether it is suspended.
+static bool display_idle_update(display_t *d, const options_t *opt) {
+  idle_state_t *idle = &d->idle;
+  idle->fully_obscured = true;
+  for (size_t i = 0; i < d->n_ov; ++i) idle->fully_obscured &= d->ovs[i].fully_obscured;
+  if (idle_hidden(idle) != idle->suspended) {
+    idle->suspended = !idle->suspended;
+    if (!idle->suspended) {
+      vsync_reset(&d->vs);
+      for (size_t i = 0; i < d->n_ov; ++i) d->ovs[i].present_all = true;
+      d->need_redraw = true;
+    }
+    if (opt->debug) {
+      fprintf(stderr, "[debug] %s %s (obscured=%d screensaver=%d dpms_off=%d)\n", display_label(d),
+              idle->suspended ? "suspended" : "resumed",
+              idle->fully_obscured, idle->saver_active, idle->dpms_off);
+    }
+  }
+  if (idle->suspended) {
+    // Still try to get back on top once; a successful raise brings an
+    // Unobscured VisibilityNotify, which resumes ticking.
+    bool sent = false;
+    for (size_t i = 0; i < d->n_ov; ++i) {
+      geometry_t *g = &d->ovs[i].geom;
+      if (g->raise_pending) sent |= apply_geometry(d->c, d->ovs[i].win, g, g->x, g->y, g->w, g->h);
+    }
+    if (sent) xcb_flush(d->c);
+  }
+  return idle->suspended;
+}
+
+// Paints d->cur into the back buffer, or into the spare one for a frame
+// rendered ahead (seeded with the frame on screen so the partial repaint
+// still holds; the back buffer keeps serving Expose until the boundary).
+// Returns false if the buffer could not be allocated.
+static bool display_paint(display_t *d, const options_t *opt, bool ahead) {
+  xcb_connection_t *cconn = d->c;
+  const frame_t *cur = &d->cur;
+  backbuf_t *target = ahead ? &d->spare : &d->bb;
+  d->target = target;
+  bool resized = backbuf_ensure(target, cconn, d->screen, d->screen->root, d->visual, cur->w, cur->h);
+  if (!backbuf_ready(target)) {
+    fprintf(stderr, "Failed to allocate a %ux%u back buffer\n", cur->w, cur->h);
+    return false;
+  }
+  if (ahead) {
+    if (!resized && d->bb.pixmap && d->bb.w == cur->w && d->bb.h == cur->h) {
+      xcb_copy_area(cconn, d->bb.pixmap, d->spare.pixmap, d->gc, 0, 0, 0, 0, cur->w, cur->h);
+    } else {
+      resized = true;
+    }
+  }
+  bool mask_new = false;
+#ifdef HAVE_CAIRO
+  if (d->bb.use_shm) shmbuf_wait(&d->bb.shm, cconn);  // never draw under a pending put
+  mask_new = d->use_linemask && linemask_ensure(&d->lm, cconn, d->screen, d->screen->root, cur->w, cur->h);
+#endif
+  d->painted = painter_damage(&d->painter, &d->last, cur, resized || mask_new, &d->dmg);
+  if (d->painted) {
+    const damage_t *dmg = &d->dmg;
+    if (opt->debug) {
+      fprintf(stderr, "[debug] repaint %s x=[%d,%d)\n", dmg->full ? "full" : "partial", dmg->x0, dmg->x1);
+    }
+#ifdef HAVE_CAIRO
+    if (d->use_linemask) {
+      // Re-rasterize only where characters changed; a color-only frame
+      // leaves the mask alone and is just the fill + composite.
+      const render_t *render = &d->painter.render;
+      frame_t text = *cur;
+      text.colors = d->last.colors;
+      damage_t mdmg;
+      if (render_damage(render, &d->last, &text, mask_new, &mdmg)) {
+        render_paint_mask(render, d->lm.mask_cr, cur, &mdmg);
+        cairo_surface_flush(d->lm.mask_surface);
+      }
+      linemask_composite(&d->lm, cconn, target->picture, &cur->colors, dmg->x0, dmg->x1);
+    } else
+#endif
+    painter_paint(&d->painter, cconn, d->gc, target, cur, dmg);
+  }
+  return true;
+}
+
+static void display_configure(display_t *d, const options_t *opt) {
+  const frame_t *cur = &d->cur;
+  for (size_t i = 0; i < d->n_ov; ++i) {
+    overlay_t *ov = &d->ovs[i];
+    int16_t new_x, new_y;
+    overlay_place(ov, cur->w, opt->margin_px, &new_x, &new_y);
+    ov->raised = ov->geom.raise_pending;
+    if (apply_geometry(d->c, ov->win, &ov->geom, new_x, new_y, cur->w, cur->h) && opt->debug) {
+      fprintf(stderr, "[debug] configure 0x%08x: %ux%u at (%d,%d)\n", ov->win, cur->w, cur->h, new_x, new_y);
+    }
+  }
+}
+
+// Copies what was exposed of d's windows from the back buffer, which holds
+// the frame on screen, without drawing a new one (while frames painted
+// ahead wait for their boundary).
+static void display_present_exposed(display_t *d) {
+  backbuf_t *bb = &d->bb;
+  if (!backbuf_ready(bb)) return;
+  for (size_t i = 0; i < d->n_ov; ++i) {
+    overlay_t *ov = &d->ovs[i];
+    rect_t r = ov->present_all ? (rect_t){ 0, 0, bb->w, bb->h } : ov->exposed;
+    if (r.x1 > bb->w) r.x1 = bb->w;
+    if (r.y1 > bb->h) r.y1 = bb->h;
+    if (rect_empty(&r)) continue;
+    backbuf_present(bb, d->c, ov->win, d->gc, d->screen->root_depth, (int16_t)r.x0, (int16_t)r.y0,
+                    (uint16_t)(r.x1 - r.x0), (uint16_t)(r.y1 - r.y0));
+    ov->present_all = false;
+    ov->exposed = (rect_t){0};
+  }
+}
+
+// Present: the damaged span, or the whole back buffer for exposed (or new)
+// windows; then the flash layer. A frame rendered ahead makes the spare
+// buffer the back buffer.
+static void display_present(display_t *d, const options_t *opt, const flash_state_t *flash,
+                            const fade_table_t *fade, int64_t now_ns) {
+  xcb_connection_t *cconn = d->c;
+  const frame_t *cur = &d->cur;
+  const uint8_t depth = d->screen->root_depth;
+  for (size_t i = 0; i < d->n_ov; ++i) {
+    overlay_t *ov = &d->ovs[i];
+    // One copy per window: the repainted span and whatever was exposed.
+    rect_t r = ov->exposed;
+    if (ov->present_all) r = (rect_t){ 0, 0, cur->w, cur->h };
+    else if (d->painted) rect_union(&r, d->dmg.x0, 0, d->dmg.x1, cur->h);
+    if (r.x1 > cur->w) r.x1 = cur->w;
+    if (r.y1 > cur->h) r.y1 = cur->h;
+    if (!rect_empty(&r)) {
+      backbuf_present(d->target, cconn, ov->win, d->gc, depth, (int16_t)r.x0, (int16_t)r.y0,
+                      (uint16_t)(r.x1 - r.x0), (uint16_t)(r.y1 - r.y0));
+    }
+    ov->present_all = false;
+    ov->exposed = (rect_t){0};
+  }
+  if (d->target == &d->spare) {
+    backbuf_t shown = d->spare;
+    d->spare = d->bb;
+    d->bb = shown;
+  }
+
+  flash_layer_t *layer = &d->layer;
+  if (layer->enabled) {
+    uint32_t opacity = flash_opacity(flash, fade, now_ns);
+    bool opacity_changed = opacity != layer->opacity;
+    layer->opacity = opacity;
+    damage_t ldmg;
+    bool lpainted = false;
+    if (opacity) {
+      bool force = false;
+      for (size_t i = 0; i < d->n_ov; ++i) force |= !d->ovs[i].layer_mapped;
+      lpainted = flash_layer_paint(layer, cconn, d->screen, d->visual, d->gc, force, &d->painter, cur,
+                                   &fade->steps[0].colors, &ldmg);
+      if (opt->debug) fprintf(stderr, "[debug] flash layer opacity=%.3f\n", opacity / (double)0xffffffffu);
+    }
+    for (size_t i = 0; i < d->n_ov; ++i) {
+      overlay_layer_update(&d->ovs[i], cconn, d->gc, depth, d->atoms[ATOM_NET_WM_WINDOW_OPACITY],
+                           layer, opacity, opacity_changed, lpainted ? &ldmg : NULL);
+    }
+  }
+}
+
+// Requests d queued since its last call, or -1 on the first call. libxcb
+// does not expose how many requests were queued, but every request gets
+// the next sequence number: a NoOperation marker per tick turns the
+// sequence delta into a request count.
+static int64_t display_requests(display_t *d) {
+  uint32_t seq = xcb_no_operation(d->c).sequence;
+  int64_t n = d->last_marker_seq ? (int64_t)(seq - d->last_marker_seq - 1) : -1;
+  d->last_marker_seq = seq;
+  return n;
+}
+
+// Replies d waited for since its last call: the few the loop can make
+// (DPMS state, RandR changes, MIT-SHM attach and put completion). Ones
+// inside cairo are not seen.
+static uint32_t display_round_trips(display_t *d) {
+  uint32_t n = d->round_trips;
+  d->round_trips = 0;
+#ifdef HAVE_CAIRO
+  n += d->bb.shm.round_trips;
+  d->bb.shm.round_trips = 0;
+#endif
+  return n;
+}
+
+// epoll sources; a control client is tagged SRC_CLIENT plus its slot, a
+// display SRC_DISPLAY plus its slot.
+enum {
+  SRC_TICK, SRC_FADE, SRC_TZ, SRC_SIGNAL, SRC_FONT, SRC_DIR, SRC_CONTROL,
+  SRC_CLIENT, SRC_DISPLAY = SRC_CLIENT + CONTROL_CLIENTS_MAX
+};
+
+static void epoll_watch(int ep, int fd, uint64_t tag) {
+  if (fd < 0) return;
+  struct epoll_event ev = { .events = EPOLLIN, .data.u64 = tag };
+  if (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) < 0) perror("epoll_ctl");
+}
+
+// The displays of the process, in stable slots (NULL when free) so an epoll
+// tag keeps naming the same one.
+typedef struct {
+  display_t *slot[DISPLAYS_MAX];
+  size_t n_slots;  // slots in use are below this
+  size_t count;
+} display_set_t;
+
+// Dumps st with the vblank counts of every display.
+static void stats_dump_displays(stats_t *st, const display_set_t *ds) {
+  st->vsync_frames = st->vsync_missed = 0;
+  for (size_t i = 0; i < ds->n_slots; ++i) {
+    if (!ds->slot[i]) continue;
+    st->vsync_frames += ds->slot[i]->vs.frames;
+    st->vsync_missed += ds->slot[i]->vs.missed;
+  }
+  stats_bytes_exclude_begin(st);  // the dump itself is not a tick's traffic
+  stats_dump(st);
+  stats_bytes_exclude_end(st);
+}
+
+// Drops the frames painted ahead; those displays lay out and paint their
+// next frame from scratch.
+static void display_set_drop_ahead(display_set_t *ds) {
+  for (size_t i = 0; i < ds->n_slots; ++i) {
+    if (ds->slot[i] && ds->slot[i]->held) display_invalidate(ds->slot[i]);
+  }
+}
+
+static bool display_set_has(const display_set_t *ds, const char *name) {
+  for (size_t i = 0; i < ds->n_slots; ++i) {
+    if (ds->slot[i] && strcmp(ds->slot[i]->name, name) == 0) return true;
+  }
+  return false;
+}
+
+// Opens name and adds it to ds and the epoll set. Returns the display, or
+// NULL if it could not be opened.
+static display_t *display_set_open(display_set_t *ds, shared_t *sh, timefmt_t *tf, int ep, const char *name) {
+  size_t i = 0;
+  while (i < DISPLAYS_MAX && ds->slot[i]) ++i;
+  if (i == DISPLAYS_MAX) {
+    fprintf(stderr, "Too many displays (at most %d), ignoring %s\n", DISPLAYS_MAX, name);
+    return NULL;
+  }
+  display_t *d = display_open(sh, name);
+  if (!d) return NULL;
+  ds->slot[i] = d;
+  if (i >= ds->n_slots) ds->n_slots = i + 1;
+  ds->count++;
+  epoll_watch(ep, xcb_get_file_descriptor(d->c), SRC_DISPLAY + i);
+  if (sh->opt->debug) fprintf(stderr, "[debug] display %s opened (%zu open)\n", display_label(d), ds->count);
+
+  // --precision: frames paced by the display refresh. Without Present on
+  // every display the sub-second digits fall back to a 10 ms timer.
+  if (sh->paced && !d->vs.present) {
+    fprintf(stderr, "Present extension unavailable, pacing --precision with a timer\n");
+    sh->paced = false;
+    tf->subsec_ns = 10 * NS_PER_MS;
+  }
+  return d;
+}
+
+static void display_set_close(display_set_t *ds, int ep, size_t i) {
+  display_t *d = ds->slot[i];
+  epoll_ctl(ep, EPOLL_CTL_DEL, xcb_get_file_descriptor(d->c), NULL);
+  display_close(d);
+  ds->slot[i] = NULL;
+  ds->count--;
+  while (ds->n_slots && !ds->slot[ds->n_slots - 1]) ds->n_slots--;
+}
+
+// Opens every display of the socket directory not open yet. Returns true if
+// one failed, to be retried (a socket can appear before its server
+// listens).
+static bool display_set_scan(display_set_t *ds, shared_t *sh, timefmt_t *tf, int ep, const displaydir_t *dir) {
+  char names[DISPLAYS_MAX][DISPLAY_NAME_MAX];
+  size_t n = displaydir_scan(dir, names, DISPLAYS_MAX);
+  bool failed = false;
+  for (size_t i = 0; i < n; ++i) {
+    if (!display_set_has(ds, names[i]) && !display_set_open(ds, sh, tf, ep, names[i])) failed = true;
+  }
+  return failed;
+}
+
+#ifdef HAVE_CAIRO
+// The font worker is done: every display gets the new font and atlas. A
+// change that fails to load keeps the previous font on screen. Returns
+// false only if the startup font could not be loaded.
+static bool font_load_done(shared_t *sh, display_set_t *ds, int ep) {
+  if (fontload_fd(&sh->fl) >= 0) epoll_ctl(ep, EPOLL_CTL_DEL, fontload_fd(&sh->fl), NULL);
+  bool reload = sh->reloading;
+  if (!shared_fonts_ready(sh)) return reload;
+  for (size_t i = 0; i < ds->n_slots; ++i) {
+    display_t *d = ds->slot[i];
+    if (!d) continue;
+    if (reload) {
+      render_destroy(&d->painter.render);
+      display_invalidate(d);
+    }
+    display_fonts_ready(sh, d);
+  }
+  return true;
+}
+
+static bool alphabet_has(const char *alphabet, const char *chars) {
+  for (; *chars; ++chars) {
+    if (!strchr(alphabet, *chars)) return false;
+  }
+  return true;
+}
+#endif
+
+// Switches *opt to next and invalidates only what the change touches:
+// colors are the fade table, a margin the layout tables and anchors, a
+// format its compiled plan (and the atlas only if it needs new characters),
+// a font the font and atlas, loaded on the worker while the old one stays
+// on screen. Connections, atoms and windows are never redone. Returns
+// false, with opt untouched and the reason in err, if next cannot be used.
+static bool options_apply(shared_t *sh, display_set_t *ds, int ep, timefmt_t *tf, fade_table_t *fade,
+                          flash_state_t *flash, options_t *opt, const options_t *next,
+                          char *err, size_t err_size) {
+  unsigned changes = settings_changes(opt, next);
+  if (!changes) return true;
+  timefmt_t ntf;
+  if (changes & SETTINGS_FORMAT) {
+    if (!timefmt_init(&ntf, next->format)) {
+      snprintf(err, err_size, "invalid format");
+      return false;
+    }
+    // Vsync pacing and --render-ahead were set up for one or the other.
+    if ((ntf.unit == TF_UNIT_SUBSEC) != (tf->unit == TF_UNIT_SUBSEC)) {
+      timefmt_destroy(&ntf);
+      snprintf(err, err_size, "sub-second fields can only change at startup");
+      return false;
+    }
+    // The --zone clocks carry over with their cached offsets.
+    for (size_t c = 1; c < tf->n_clocks; ++c) {
+      ntf.clocks[ntf.n_clocks] = tf->clocks[c];
+      ntf.clocks[ntf.n_clocks++].valid = false;
+    }
+  }
+  // Rejected rather than cut short: every zone and status segment must fit.
+  if (changes & (SETTINGS_FORMAT | SETTINGS_FLASH)) {
+    size_t w = timefmt_max_width(changes & SETTINGS_FORMAT ? &ntf : tf) +
+               status_max_width(sh->status, next->show_flash_count);
+    if (w >= FRAME_TEXT_MAX) {
+      if (changes & SETTINGS_FORMAT) timefmt_destroy(&ntf);
+      snprintf(err, err_size, "the display string can reach %zu characters (max %d)", w, FRAME_TEXT_MAX - 1);
+      return false;
+    }
+  }
+#ifdef HAVE_CAIRO
+  // A load still running reads the old options' strings; take it first.
+  if (fontload_fd(&sh->fl) >= 0) font_load_done(sh, ds, ep);
+#else
+  (void)sh;
+#endif
+  if (opt->debug) {
+    fprintf(stderr, "[debug] settings changed:%s%s%s%s%s\n",
+            changes & SETTINGS_COLORS ? " colors" : "", changes & SETTINGS_FONT ? " font" : "",
+            changes & SETTINGS_MARGIN ? " margin" : "", changes & SETTINGS_FORMAT ? " format" : "",
+            changes & SETTINGS_FLASH ? " flash" : "");
+  }
+  *opt = *next;
+
+  if (changes & SETTINGS_COLORS) fade_table_init(fade, opt);
+  if ((changes & SETTINGS_FLASH) && opt->flash_minutes <= 0) flash->active = false;
+  if (changes & SETTINGS_FORMAT) {
+    if (timefmt_tz_fd(tf) >= 0) epoll_ctl(ep, EPOLL_CTL_DEL, timefmt_tz_fd(tf), NULL);
+    ntf.subsec_ns = tf->subsec_ns;  // keeps a timer fallback for --precision
+    timefmt_destroy(tf);
+    *tf = ntf;
+    epoll_watch(ep, timefmt_tz_fd(tf), SRC_TZ);
+  }
+#ifdef HAVE_CAIRO
+  if (opt->backend != BACKEND_BITMAP) {
+    char charset[ATLAS_CHARS_MAX];
+    timefmt_charset(tf, charset, sizeof(charset));
+    status_charset(sh->status, charset, sizeof(charset));
+    if (changes & SETTINGS_MARGIN) render_set_pad(&sh->master, opt->margin_px);
+    if ((changes & SETTINGS_FONT) || ((changes & SETTINGS_FORMAT) && !alphabet_has(sh->master.alphabet, charset))) {
+      sh->reloading = true;
+      fontload_start(&sh->fl, &sh->pending, opt, charset);
+      if (fontload_fd(&sh->fl) >= 0) epoll_watch(ep, fontload_fd(&sh->fl), SRC_FONT);
+      else font_load_done(sh, ds, ep);
+    }
+  }
+#endif
+  for (size_t i = 0; i < ds->n_slots; ++i) {
+    display_t *d = ds->slot[i];
+    if (!d) continue;
+    painter_t *p = &d->painter;
+    if ((changes & SETTINGS_FONT) && p->bitmap) {
+      // The pixel font only scales; nothing to load.
+      bitmap_destroy(&p->bm);
+      if (!bitmap_init(&p->bm, opt, d->c, d->screen, d->visual)) {
+        display_set_close(ds, ep, i);
+        continue;
+      }
+      display_invalidate(d);
+    }
+    if (changes & SETTINGS_MARGIN) {
+#ifdef HAVE_CAIRO
+      if (!p->bitmap) render_set_pad(&p->render, opt->margin_px);
+#endif
+      if (p->bitmap) p->bm.pad = opt->margin_px;
+      for (size_t j = 0; j < d->n_ov; ++j) d->ovs[j].place_dirty = true;
+      display_invalidate(d);
+    }
+    d->need_redraw = true;
+  }
+  return true;
+}
+
+// A setting given on the command line. Every --config load replays these
+// over the file, so the command line keeps precedence.
+typedef struct {
+  const char *key;
+  const char *value;
+} cli_setting_t;
+
+#define CLI_SETTINGS_MAX 16
+
+// Where the running options come from, for reloads and the control socket.
+typedef struct {
+  options_t defaults;
+  const char *config;  // --config file, NULL if none
+  cli_setting_t cli[CLI_SETTINGS_MAX];
+  size_t n_cli;
+  settings_t store[2]; // strings of the running options and of a change being built
+  int cur;             // store of the running options
+} option_source_t;
+
+// Index of the long option with getopt value val.
+static size_t idx_of(const struct option *opts, int val) {
+  size_t i = 0;
+  while (opts[i].name && opts[i].val != val) ++i;
+  return i;
+}
+
+// Applies a settings option from the command line (long option name key).
+// Prints the problem and returns false if its value is invalid.
+static bool cli_setting(option_source_t *src, options_t *opt, const char *key, const char *value) {
+  char err[64];
+  if (!settings_set(&src->store[src->cur], opt, key, value, err, sizeof(err))) {
+    fprintf(stderr, "Invalid --%s, %s\n", key, err);
+    return false;
+  }
+  size_t i = 0;
+  while (i < src->n_cli && strcmp(src->cli[i].key, key) != 0) ++i;
+  if (i == src->n_cli && src->n_cli < CLI_SETTINGS_MAX) src->n_cli++;
+  if (i < CLI_SETTINGS_MAX) src->cli[i] = (cli_setting_t){ key, value };
+  return true;
+}
+
+// Rebuilds *out from the defaults, the --config file and the command line,
+// with its strings in s. Leaves both untouched if the file is invalid.
+static bool options_load(const option_source_t *src, options_t *out, settings_t *s) {
+  options_t o = *out;
+  settings_t tmp = {0};
+  settings_reset(&o, &src->defaults);
+  if (!settings_load(&tmp, &o, src->config)) return false;
+  char err[64];
+  for (size_t i = 0; i < src->n_cli; ++i) settings_set(&tmp, &o, src->cli[i].key, src->cli[i].value, err, sizeof(err));
+  settings_finish(&tmp, &o);
+  settings_copy(s, &tmp, &o);
+  *out = o;
+  return true;
+}
+
+// Builds *next from opt and the commands client i sent, in the spare
+// settings store, and writes one reply line per command to reply. Returns
+// whether a setting changed; *show asks for the settings once applied.
+static bool control_commands(control_t *ctl, int i, option_source_t *src, const options_t *opt,
+                             options_t *next, char *reply, size_t size, bool *show) {
+  settings_t *s = &src->store[!src->cur];
+  *next = *opt;
+  settings_copy(s, &src->store[src->cur], next);
+  bool changed = false;
+  size_t len = 0;
+  reply[0] = '\0';
+  char *line;
+  while ((line = control_line(ctl, i)) != NULL) {
+    char *cmd = line + strspn(line, " \t");
+    if (!*cmd) continue;
+    char *args = cmd + strcspn(cmd, " \t");
+    if (*args) *args++ = '\0';
+    args += strspn(args, " \t");
+    char err[96] = "";
+    bool ok = true;
+    if (strcmp(cmd, "set") == 0) {
+      char *value = args + strcspn(args, " \t");
+      if (*value) *value++ = '\0';
+      value += strspn(value, " \t");
+      if (!*args) {
+        snprintf(err, sizeof(err), "usage: set KEY VALUE");
+        ok = false;
+      } else {
+        ok = settings_set(s, next, args, value, err, sizeof(err));
+      }
+      changed |= ok;
+    } else if (strcmp(cmd, "reload") == 0) {
+      if (!src->config) snprintf(err, sizeof(err), "no --config file");
+      else if (!options_load(src, next, s)) snprintf(err, sizeof(err), "invalid --config file");
+      ok = !err[0];
+      changed |= ok;
+    } else if (strcmp(cmd, "show") == 0) {
+      *show = true;
+    } else {
+      snprintf(err, sizeof(err), "unknown command, use set, reload or show");
+      ok = false;
+    }
+    if (len < size) len += (size_t)snprintf(reply + len, size - len, ok ? "ok\n" : "error: %s\n", err);
+  }
+  settings_finish(s, next);
+  return changed;
 }
 
 int main(int argc, char **argv) {
-  options_t opt = {
+  const int64_t t0_ns = mono_now_ns();
+  const options_t defaults = {
     .font_family = "DejaVu Sans Mono",
     .font_size_px = 14.0,
     .margin_px = 0,
     .fg_r = 1.0, .fg_g = 1.0, .fg_b = 1.0,
     .bg_r = 0.0, .bg_g = 0.0, .bg_b = 0.0,
     .time_only = false,
+    .format = NULL,
     .debug = false,
     .flash_minutes = 0,
-    .show_flash_count = false
+    .show_flash_count = false,
+    .flash_mode = FLASH_MODE_CLIENT,
+    .backend = DEFAULT_BACKEND,
+    .outputs = NULL,
+    .precision = PRECISION_NONE,
+    .render_ahead_ms = 0,
+    .atlas_cache = true
   };
+  options_t opt = defaults;
+  option_source_t src = { .defaults = defaults };
 
   static struct option long_opts[] = {
     {"help",      no_argument,       0, 'h'},
@@ -212,304 +1784,726 @@ int main(int argc, char **argv) {
     {"flash",     required_argument, 0, 'F'},
     {"show-flash-count", no_argument, 0, 'c'},
     {"debug",     no_argument,       0, 'd'},
+    {"bench",     required_argument, 0,  3  },
+    {"stats",     no_argument,       0,  4  },
+    {"stats-file", required_argument, 0, 5  },
+    {"backend",   required_argument, 0,  6  },
+    {"flash-mode", required_argument, 0, 7  },
+    {"outputs",   required_argument, 0,  8  },
+    {"format",    required_argument, 0,  9  },
+    {"precision", required_argument, 0, 10  },
+    {"render-ahead", required_argument, 0, 11 },
+    {"no-atlas-cache", no_argument,    0, 12 },
+    {"displays",  required_argument, 0, 13  },
+    {"display-dir", required_argument, 0, 14 },
+    {"control",   required_argument, 0, 15  },
+    {"config",    required_argument, 0, 16  },
+    {"zone",      required_argument, 0, 17  },
+    {"status",    required_argument, 0, 18  },
+    {"exit-after", required_argument, 0, 19 },
+    {"stats-budget", required_argument, 0, 20 },
     {0,0,0,0}
   };
 
+  long bench_frames = 0;
+  bool stats_on = false;
+  const char *stats_path = NULL;
+  const char *displays_list = NULL;
+  const char *display_dir = NULL;
+  const char *control_path = NULL;
+  const char *zones[TIMEFMT_ZONES_MAX];
+  size_t n_zones = 0;
+  const char *status_list = NULL;
+  long exit_after_s = 0;
+  double budget_requests = 0, budget_bytes = 0;
+  bool budget = false;
   int c, idx;
   while ((c = getopt_long(argc, argv, "hf:s:m:tF:cd", long_opts, &idx)) != -1) {
     switch (c) {
       case 'h': print_help(argv[0]); return 0;
-      case 'f': opt.font_family = optarg; break;
-      case 's': opt.font_size_px = strtod(optarg, NULL); if (opt.font_size_px <= 0) opt.font_size_px = 16.0; break;
-      case 'm': opt.margin_px = (uint32_t)strtoul(optarg, NULL, 10); break;
-      case 't': opt.time_only = true; break;
-      case 'F': {
+      case 'd': opt.debug = true; break;
+      // The settings (settings.h), also changeable at runtime.
+      case 'f': case 's': case 'm': case 't': case 'F': case 'c': case 1: case 2: case 9:
+        if (!cli_setting(&src, &opt, long_opts[idx_of(long_opts, c)].name, optarg ? optarg : "")) return 2;
+        break;
+      case 3:
+#ifndef HAVE_CAIRO
+        fprintf(stderr, "--bench needs cairo; this build has only the bitmap backend\n"); return 2;
+#endif
+        bench_frames = strtol(optarg, NULL, 10);
+        if (bench_frames <= 0) {
+          fprintf(stderr, "Invalid --bench count, use a positive number of frames\n"); return 2;
+        }
+        break;
+      case 4: stats_on = true; break;
+      case 5: stats_on = true; stats_path = optarg; break;
+      case 6:
+        if (strcmp(optarg, "xcb") == 0) opt.backend = BACKEND_XCB;
+        else if (strcmp(optarg, "shm") == 0) opt.backend = BACKEND_SHM;
+        else if (strcmp(optarg, "xrender") == 0) opt.backend = BACKEND_XRENDER;
+        else if (strcmp(optarg, "bitmap") == 0) opt.backend = BACKEND_BITMAP;
+        else {
+          fprintf(stderr, "Invalid --backend, use xcb, shm, xrender or bitmap\n"); return 2;
+        }
+#ifndef HAVE_CAIRO
+        if (opt.backend != BACKEND_BITMAP) {
+          fprintf(stderr, "Built without cairo: only --backend bitmap is available\n"); return 2;
+        }
+#endif
+        break;
+      case 7:
+        if (strcmp(optarg, "client") == 0) opt.flash_mode = FLASH_MODE_CLIENT;
+        else if (strcmp(optarg, "compositor") == 0) opt.flash_mode = FLASH_MODE_COMPOSITOR;
+        else {
+          fprintf(stderr, "Invalid --flash-mode, use client or compositor\n"); return 2;
+        }
+        break;
+      case 8: opt.outputs = optarg; break;
+      case 10:
+        if (strcmp(optarg, "ms") == 0) opt.precision = PRECISION_MS;
+        else if (strcmp(optarg, "cs") == 0) opt.precision = PRECISION_CS;
+        else {
+          fprintf(stderr, "Invalid --precision, use ms or cs\n"); return 2;
+        }
+        break;
+      case 11: {
           long v = strtol(optarg, NULL, 10);
-          if (v < 0) v = 0;
-          opt.flash_minutes = (int)v;
+          if (v <= 0 || v > 500) {
+            fprintf(stderr, "Invalid --render-ahead, use a lead of 1-500 ms\n"); return 2;
+          }
+          opt.render_ahead_ms = (int)v;
         } break;
-      case 'c': opt.show_flash_count = true; break;
-      case 'd': opt.debug = true; break;
-      case 1:
-        if (!parse_rgb_hex(optarg, &opt.fg_r, &opt.fg_g, &opt.fg_b)) {
-          fprintf(stderr, "Invalid --fg color, use #RRGGBB\n"); return 2;
+      case 12: opt.atlas_cache = false; break;
+      case 13: displays_list = optarg; break;
+      case 14: display_dir = optarg; break;
+      case 15: control_path = optarg; break;
+      case 16: src.config = optarg; break;
+      case 17:
+        if (n_zones == TIMEFMT_ZONES_MAX) {
+          fprintf(stderr, "Too many --zone (max %d)\n", TIMEFMT_ZONES_MAX); return 2;
         }
+        zones[n_zones++] = optarg;
         break;
-      case 2:
-        if (!parse_rgb_hex(optarg, &opt.bg_r, &opt.bg_g, &opt.bg_b)) {
-          fprintf(stderr, "Invalid --bg color, use #RRGGBB\n"); return 2;
+      case 18: status_list = optarg; break;
+      case 19:
+        exit_after_s = strtol(optarg, NULL, 10);
+        if (exit_after_s <= 0) {
+          fprintf(stderr, "Invalid --exit-after, use a number of seconds\n"); return 2;
         }
         break;
+      case 20: {
+          char *end;
+          budget_requests = strtod(optarg, &end);
+          if (*end == ',') budget_bytes = strtod(end + 1, &end);
+          if (*end || budget_requests < 0 || budget_bytes < 0 || (!budget_requests && !budget_bytes)) {
+            fprintf(stderr, "Invalid --stats-budget, use REQUESTS[,BYTES] per tick\n"); return 2;
+          }
+          budget = stats_on = true;
+        } break;
       default:  print_help(argv[0]); return 2;
     }
   }
 
-  if (opt.debug) {
-    fprintf(stderr, "[debug] opts: font=\"%s\" size=%.1f margin=%u time_only=%d flash_minutes=%d show_flash_count=%d fg=%.3f,%.3f,%.3f bg=%.3f,%.3f,%.3f\n",
-            opt.font_family, opt.font_size_px, opt.margin_px, opt.time_only, opt.flash_minutes,
-            opt.show_flash_count, opt.fg_r, opt.fg_g, opt.fg_b, opt.bg_r, opt.bg_g, opt.bg_b);
+  if (budget && !exit_after_s) {
+    fprintf(stderr, "--stats-budget needs --exit-after\n");
+    return 2;
+  }
+  if (budget_bytes && opt.debug) {
+    fprintf(stderr, "--stats-budget BYTES cannot be checked with --debug, whose output counts as written\n");
+    return 2;
   }
 
-  int screen_num = 0;
-  xcb_connection_t *cconn = xcb_connect(NULL, &screen_num);
-  if (!cconn || xcb_connection_has_error(cconn)) {
-    fprintf(stderr, "Failed to connect to X server\n");
-    return 1;
+  // --config: the file over the defaults, the command line over the file.
+  if (src.config) {
+    if (!options_load(&src, &opt, &src.store[src.cur])) return 2;
+  } else {
+    settings_finish(&src.store[src.cur], &opt);
   }
 
-  const xcb_setup_t *setup = xcb_get_setup(cconn);
-  xcb_screen_iterator_t iter = xcb_setup_roots_iterator(setup);
-  for (int s = 0; s < screen_num; ++s) xcb_screen_next(&iter);
-  xcb_screen_t *screen = iter.data;
-  if (!screen) {
-    fprintf(stderr, "Could not get default screen\n");
-    xcb_disconnect(cconn);
-    return 1;
+#ifdef HAVE_CAIRO
+  if (bench_frames > 0) {
+    return bench_run(&opt, bench_frames);
   }
+#endif
+
   if (opt.debug) {
-    fprintf(stderr, "[debug] screen: %ux%u, screen_num=%d\n",
-            screen->width_in_pixels, screen->height_in_pixels, screen_num);
+    fprintf(stderr, "[debug] opts: font=\"%s\" size=%.1f margin=%u format=\"%s\" flash_minutes=%d show_flash_count=%d fg=%.3f,%.3f,%.3f bg=%.3f,%.3f,%.3f\n",
+            opt.font_family, opt.font_size_px, opt.margin_px, opt.format, opt.flash_minutes,
+            opt.show_flash_count, opt.fg_r, opt.fg_g, opt.fg_b, opt.bg_r, opt.bg_g, opt.bg_b);
   }
 
-  xcb_visualtype_t *visual = get_visualtype_for_screen(setup, screen);
-  if (!visual) {
-    fprintf(stderr, "Could not find visual for screen\n");
-    xcb_disconnect(cconn);
-    return 1;
+  // Clock string formatter: the template is compiled (and rejected) before
+  // connecting; it also watches /etc/localtime for timezone changes. Every
+  // display shows the same string, --zone clocks included, so it is
+  // formatted once per tick.
+  timefmt_t tf;
+  if (!timefmt_init(&tf, opt.format)) return 2;
+  for (size_t i = 0; i < n_zones; ++i) {
+    if (!timefmt_add_zone(&tf, zones[i])) return 2;
+  }
+  // Segments after the clock; the flash count is the first.
+  status_t status;
+  status_init(&status);
+  if (status_list && !status_add(&status, status_list)) return 2;
+  size_t text_w = timefmt_max_width(&tf) + status_max_width(&status, opt.show_flash_count);
+  if (text_w >= FRAME_TEXT_MAX) {
+    fprintf(stderr, "The clock and --status can reach %zu characters (max %d); use fewer zones or segments\n",
+            text_w, FRAME_TEXT_MAX - 1);
+    return 2;
   }
-
-  // Create override-redirect window so the WM doesn't manage it and it stays above.
-  xcb_window_t win = xcb_generate_id(cconn);
-  uint32_t cw_values[2];
-  uint32_t cw_mask = XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK;
-  cw_values[0] = 1; // override-redirect = true
-  cw_values[1] = XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_VISIBILITY_CHANGE;
-
-  // Initial tiny size; will be resized after measuring text.
-  uint16_t w = 64, h = 24;
-  xcb_create_window(
-    cconn,
-    XCB_COPY_FROM_PARENT,              // depth
-    win,
-    screen->root,
-    screen->width_in_pixels - w - opt.margin_px, // x
-    opt.margin_px,                              // y
-    w, h,
-    0,                                // border
-    XCB_WINDOW_CLASS_INPUT_OUTPUT,
-    screen->root_visual,
-    cw_mask, cw_values
-  );
   if (opt.debug) {
-    fprintf(stderr, "[debug] created window id=0x%08x\n", win);
+    fprintf(stderr, "[debug] format plan: %zu segments, changes every %s\n",
+            tf.n_segs, timefmt_unit_name(tf.unit));
+    for (size_t i = 1; i < tf.n_clocks; ++i) {
+      const tf_clock_t *k = &tf.clocks[i];
+      fprintf(stderr, "[debug] zone %s: %s UTC%+ld s, next change at %lld (%s)\n", k->zone, k->abbr,
+              k->utcoff, (long long)k->until, k->next_abbr);
+    }
   }
 
-  // Make the window click-through (no input), so it never steals focus.
-  xcb_shape_rectangles(
-    cconn,
-    XCB_SHAPE_SO_SET,
-    XCB_SHAPE_SK_INPUT,
-    XCB_CLIP_ORDERING_UNSORTED,
-    win,
-    0, 0,
-    0,
-    NULL
-  );
+  shared_t sh = { .opt = &opt, .t0_ns = t0_ns, .status = &status };
+  sh.want_vsync = opt.precision != PRECISION_NONE && tf.unit == TF_UNIT_SUBSEC;
+  sh.paced = sh.want_vsync;
+  // --render-ahead: sub-second plans have no slack worth using.
+  sh.lead_ns = (int64_t)opt.render_ahead_ms * NS_PER_MS;
+  sh.ahead_on = sh.lead_ns > 0;
+  if (sh.ahead_on && tf.unit == TF_UNIT_SUBSEC) {
+    fprintf(stderr, "--render-ahead needs a format without sub-second fields\n");
+    sh.ahead_on = false;
+  }
 
-  set_evmh_hints(cconn, win);
+  // SIGUSR1 (--stats) and SIGHUP (--config) are delivered through a
+  // signalfd in the poll set, so a dump or reload happens between ticks and
+  // never interrupts a frame. They are blocked before the font worker
+  // starts: a thread with them unblocked would take them with the default
+  // action and kill the process.
+  stats_t st;
+  stats_init(&st, stats_on, stats_path);
+  int sig_fd = -1;
+  if (st.enabled || src.config) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    if (st.enabled) sigaddset(&mask, SIGUSR1);
+    if (src.config) sigaddset(&mask, SIGHUP);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    sig_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sig_fd < 0) perror("signalfd");
+  }
 
-  // Map and raise
-  xcb_map_window(cconn, win);
-  uint32_t cfg_vals[1] = { XCB_STACK_MODE_ABOVE };
-  xcb_configure_window(cconn, win, XCB_CONFIG_WINDOW_STACK_MODE, cfg_vals);
-  xcb_flush(cconn);
+  // Resolve the font (fontconfig/FreeType, or the atlas cache) and
+  // rasterize the atlas on a worker thread, overlapped with the whole X
+  // setup below; the loop draws the first frame once it is done. It is
+  // loaded once for all displays. The bitmap font has nothing to load.
+#ifdef HAVE_CAIRO
+  if (opt.backend != BACKEND_BITMAP) {
+    char charset[ATLAS_CHARS_MAX];
+    timefmt_charset(&tf, charset, sizeof(charset));
+    status_charset(&status, charset, sizeof(charset));
+    fontload_start(&sh.fl, &sh.master, &opt, charset);
+  }
+#endif
 
-  // Prepare a dummy cairo surface/context for text metrics (offscreen).
-  cairo_surface_t *measure_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
-  cairo_t *measure_cr = cairo_create(measure_surface);
-  cairo_select_font_face(measure_cr, opt.font_family, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-  cairo_set_font_size(measure_cr, opt.font_size_px);
+  // Every source (X connections, timers, signals, the font worker, the
+  // socket directory) is one epoll set, so adding a display costs a
+  // registration rather than a longer poll array per wakeup.
+  int ep = epoll_create1(EPOLL_CLOEXEC);
+  if (ep < 0) {
+    perror("epoll_create1");
+    return 1;
+  }
+  display_set_t ds = {0};
+  displaydir_t dir = { .fd = -1 };
+  if (display_dir && !displaydir_init(&dir, display_dir)) return 1;
+  if (displays_list) {
+    char list[1024];
+    snprintf(list, sizeof(list), "%s", displays_list);
+    char *save = NULL;
+    for (char *name = strtok_r(list, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+      if (!display_set_has(&ds, name)) display_set_open(&ds, &sh, &tf, ep, name);
+    }
+  } else if (!display_dir) {
+    display_set_open(&ds, &sh, &tf, ep, NULL);
+  }
+  bool retry_scan = false;
+  int scan_retries = DISPLAYDIR_RETRIES;
+  if (display_dir) retry_scan = display_set_scan(&ds, &sh, &tf, ep, &dir);
+  if (ds.count == 0 && !display_dir) return 1;
+
+#ifdef HAVE_CAIRO
+  // Without a worker thread the font was loaded synchronously.
+  if (opt.backend != BACKEND_BITMAP && fontload_fd(&sh.fl) < 0 && !font_load_done(&sh, &ds, ep)) return 1;
+#endif
 
   // Flash state (boundary-aligned)
-  flash_state_t flash = { .active = false, .start = 0, .last_boundary_min_epoch = -1 };
-  uint64_t flash_count = 0;
+  flash_state_t flash;
+  flash_init(&flash);
+  fade_table_t fade;
+  fade_table_init(&fade, &opt);
 
-  // Main loop: poll X for events. During flash, update every 50ms; otherwise,
-  // sleep to next second to keep CPU minimal.
-  int xfd = xcb_get_file_descriptor(cconn);
-  char last_str[128] = {0};
+  // Main loop: X events of every display, a timerfd firing on absolute
+  // second boundaries and, during a flash, a monotonic timerfd that fires
+  // only when the faded color changes. Both timers are shared.
+  int tfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+  int fade_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  // The first tick fires immediately; every frame then re-arms the timer
+  // for the next change, and tick_at remembers that deadline ({0}: unarmed).
+  struct timespec tick_at;
+  clock_gettime(CLOCK_REALTIME, &tick_at);
+  struct timespec tick_deadline = tick_at;  // deadline of the tick being served
+  if (tfd < 0 || fade_fd < 0 || !tick_timer_arm(tfd, &tick_at)) {
+    perror("timerfd");
+    return 1;
+  }
 
-  for (;;) {
-    long timeout_ms = flash.active ? FLASH_STEP_MS : ms_to_next_second();
+  epoll_watch(ep, tfd, SRC_TICK);
+  epoll_watch(ep, fade_fd, SRC_FADE);
+  epoll_watch(ep, timefmt_tz_fd(&tf), SRC_TZ);
+  epoll_watch(ep, sig_fd, SRC_SIGNAL);
+  epoll_watch(ep, displaydir_fd(&dir), SRC_DIR);
+#ifdef HAVE_CAIRO
+  if (!sh.fonts_loaded) epoll_watch(ep, fontload_fd(&sh.fl), SRC_FONT);
+#endif
 
-    struct pollfd pfd = { .fd = xfd, .events = POLLIN };
-    int pr = poll(&pfd, 1, (int)timeout_ms);
-    if (pr < 0 && errno == EINTR) continue;
+  // --control: settings changes from a UNIX socket, served by this loop.
+  control_t ctl = { .fd = -1 };
+  if (control_path) {
+    if (!control_open(&ctl, control_path)) return 1;
+    epoll_watch(ep, control_fd(&ctl), SRC_CONTROL);
+  }
 
-    bool need_redraw = false;
+  bool first_frame = true;
+  bool suspended = false;  // every display is suspended (or there is none)
+  bool fatal = false;
+  // --render-ahead: frames painted ahead wait for the tick timer, re-armed
+  // for their boundary, while the loop keeps serving every other source.
+  bool ahead_pending = false;
+  int64_t ahead_paint_ns = 0;  // their paint time, for --stats
+  // --exit-after: a scripted run (e.g. --stats-budget under Xvfb) ends here.
+  // A budget run with --flash measures from its first flash instead, so the
+  // share of fade frames does not depend on when in the minute it started.
+  bool budget_wait = budget && opt.flash_minutes > 0;
+  int64_t exit_at_ns = exit_after_s ? mono_now_ns() + exit_after_s * NS_PER_SEC : 0;
+  if (budget_wait) exit_at_ns += (int64_t)opt.flash_minutes * 60 * NS_PER_SEC;  // a flash is due by then
 
-    // Drain events (lightweight; we only care about expose/visibility)
-    xcb_generic_event_t *ev;
-    while ((ev = xcb_poll_for_event(cconn)) != NULL) {
-      uint8_t rt = ev->response_type & ~0x80;
-      if (opt.debug) {
-        fprintf(stderr, "[debug] event: %s (%u)\n", event_name(rt), rt);
-      }
-      if (rt == XCB_EXPOSE || rt == XCB_VISIBILITY_NOTIFY || rt == XCB_CONFIGURE_NOTIFY) {
-        need_redraw = true;
-      }
-      free(ev);
+  while (!fatal) {
+    struct epoll_event evs[16];
+    int timeout_ms = retry_scan ? DISPLAYDIR_RETRY_MS : -1;
+    if (exit_at_ns) {
+      int64_t left_ns = exit_at_ns - mono_now_ns();
+      if (left_ns <= 0) break;
+      int left_ms = (int)((left_ns + NS_PER_MS - 1) / NS_PER_MS);
+      if (timeout_ms < 0 || left_ms < timeout_ms) timeout_ms = left_ms;
+    }
+    int pr = epoll_wait(ep, evs, 16, timeout_ms);
+    if (pr < 0 && errno == EINTR) continue;
+    if (pr < 0) {
+      perror("epoll_wait");
+      break;
     }
+    stats_wakeup(&st);
+
+    bool redraw_all = false;
+    bool boundary_tick = false;
+    bool ahead_frame = false;     // paint now, present at tick_deadline
+    bool ahead_boundary = false;  // present the frames painted ahead
+    bool rescan = pr == 0 && retry_scan;
+    bool reload = false;         // SIGHUP: re-read --config
+    bool reconfigured = false;   // settings changed
 
-    // Tick
-    if (pr == 0) {
-      need_redraw = true;
-    }
-
-    if (need_redraw) {
-      time_t now = time(NULL);
-      struct tm lt;
-      localtime_r(&now, &lt);
-
-      // Boundary-aligned flash trigger: minute % flash_minutes == 0 at sec 00
-      if (opt.flash_minutes > 0) {
-        long epoch_min = (long)(now / 60);
-        if (!flash.active && lt.tm_sec == 0 && (lt.tm_min % opt.flash_minutes) == 0) {
-          if (flash.last_boundary_min_epoch != epoch_min) {
-            flash.active = true;
-            flash.start = now;
-            flash.last_boundary_min_epoch = epoch_min;
-            flash_count++;
-            if (opt.debug) {
-              fprintf(stderr, "[debug] flash start: epoch_min=%ld (time %02d:%02d) count=%llu\n",
-                      epoch_min, lt.tm_hour, lt.tm_min,
-                      (unsigned long long)flash_count);
-            }
+    for (int e = 0; e < pr; ++e) {
+      uint64_t tag = evs[e].data.u64;
+      if (tag == SRC_TICK) {
+        // Tick: second boundary (or its lead), clock step
+        ahead_boundary = ahead_pending;
+        ahead_pending = false;
+        tick_deadline = tick_at;
+        ahead_frame = sh.ahead_on && tick_at.tv_sec && !ahead_boundary;
+        if (tick_timer_read(tfd)) {
+          tick_at = (struct timespec){0};
+          ahead_frame = ahead_boundary = false;
+          display_set_drop_ahead(&ds);
+          timefmt_invalidate(&tf);
+          if (opt.debug) fprintf(stderr, "[debug] clock was set; re-synced tick timer\n");
+        }
+        redraw_all = true;
+        boundary_tick = true;
+      } else if (tag == SRC_FADE) {
+        uint64_t expirations;
+        if (read(fade_fd, &expirations, sizeof(expirations)) > 0) redraw_all = true;
+      } else if (tag == SRC_TZ) {
+        if (timefmt_handle_tz(&tf)) {
+          if (opt.debug) fprintf(stderr, "[debug] timezone changed\n");
+          redraw_all = true;
+        }
+      } else if (tag == SRC_SIGNAL) {
+        struct signalfd_siginfo si;
+        while (read(sig_fd, &si, sizeof(si)) == (ssize_t)sizeof(si)) {
+          if (si.ssi_signo == SIGHUP) {
+            reload = true;
+            continue;
           }
+          stats_dump_displays(&st, &ds);
         }
-        if (flash.active) {
-          double elapsed = difftime(now, flash.start);
-          if (elapsed >= FLASH_DURATION_SEC) {
-            flash.active = false;
-            if (opt.debug) fprintf(stderr, "[debug] flash end (count=%llu)\n",
-                                   (unsigned long long)flash_count);
+#ifdef HAVE_CAIRO
+      } else if (tag == SRC_FONT) {
+        // The worker is done: the first frames (or the new font) can be
+        // drawn. It may already have been taken by a settings change.
+        if (fontload_fd(&sh.fl) >= 0 && !font_load_done(&sh, &ds, ep)) {
+          fatal = true;
+          break;
+        }
+#endif
+      } else if (tag == SRC_CONTROL) {
+        int i = control_accept(&ctl);
+        if (i >= 0) epoll_watch(ep, control_client_fd(&ctl, i), SRC_CLIENT + (uint64_t)i);
+      } else if (tag >= SRC_CLIENT && tag < SRC_CLIENT + CONTROL_CLIENTS_MAX) {
+        int i = (int)(tag - SRC_CLIENT);
+        if (control_client_fd(&ctl, i) < 0) continue;
+        bool alive = control_read(&ctl, i);
+        char reply[1024], err[96];
+        bool show = false;
+        options_t next;
+        if (control_commands(&ctl, i, &src, &opt, &next, reply, sizeof(reply), &show)) {
+          if (options_apply(&sh, &ds, ep, &tf, &fade, &flash, &opt, &next, err, sizeof(err))) {
+            src.cur = !src.cur;
+            reconfigured = true;
+          } else {
+            size_t len = strlen(reply);
+            snprintf(reply + len, sizeof(reply) - len, "error: %s, nothing changed\n", err);
           }
         }
+        stats_bytes_exclude_begin(&st);
+        control_reply(&ctl, i, reply);
+        if (show) {
+          char text[1024];
+          settings_format(&src.store[src.cur], &opt, text, sizeof(text));
+          control_reply(&ctl, i, text);
+        }
+        stats_bytes_exclude_end(&st);
+        if (!alive) {
+          epoll_ctl(ep, EPOLL_CTL_DEL, control_client_fd(&ctl, i), NULL);
+          control_drop(&ctl, i);
+        }
+      } else if (tag == SRC_DIR) {
+        if (displaydir_handle(&dir)) {
+          rescan = true;
+          scan_retries = DISPLAYDIR_RETRIES;
+        }
+      } else if (tag - SRC_DISPLAY < ds.n_slots && ds.slot[tag - SRC_DISPLAY]) {
+        ds.slot[tag - SRC_DISPLAY]->readable = true;
       }
+    }
+    if (fatal) break;
 
-      char nowbuf[64];
-      now_timestr(nowbuf, sizeof(nowbuf), opt.time_only);
-
-      // Compose display string with optional flash count
-      char dispbuf[128];
-      if (opt.show_flash_count && flash_count > 0) {
-        snprintf(dispbuf, sizeof(dispbuf), "%s (%llu)", nowbuf,
-                 (unsigned long long)flash_count);
+    if (reload) {
+      options_t next = opt;
+      char err[96];
+      if (!options_load(&src, &next, &src.store[!src.cur])) {
+        fprintf(stderr, "Reloading %s failed, keeping the current settings\n", src.config);
+      } else if (!options_apply(&sh, &ds, ep, &tf, &fade, &flash, &opt, &next, err, sizeof(err))) {
+        fprintf(stderr, "Reloading %s failed (%s), keeping the current settings\n", src.config, err);
       } else {
-        snprintf(dispbuf, sizeof(dispbuf), "%s", nowbuf);
+        src.cur = !src.cur;
+        reconfigured = true;
       }
+    }
+    if (reconfigured) {
+      // The plan, flash interval or fade may have changed: re-arm both
+      // timers from the next frame, which every display draws.
+      tick_at = (struct timespec){0};
+      if (!flash.active) fade_timer_arm(fade_fd, 0);
+      redraw_all = true;
+      ahead_pending = false;
+      display_set_drop_ahead(&ds);
+    }
 
-      // Re-measure text
-      cairo_select_font_face(measure_cr, opt.font_family, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-      cairo_set_font_size(measure_cr, opt.font_size_px);
+    // Drain events (lightweight; we only care about expose/visibility).
+    // Displays whose socket was not readable may still have events queued
+    // by an earlier reply wait.
+    int64_t ts = stats_now(&st);
+    for (size_t i = 0; i < ds.n_slots; ++i) {
+      display_t *d = ds.slot[i];
+      if (!d) continue;
+      d->need_redraw |= redraw_all;
+      bool readable = d->readable;
+      d->readable = false;
+      if (!display_events(d, &opt, sh.paced, readable)) {
+        fprintf(stderr, "Lost connection to display %s\n", display_label(d));
+        display_set_close(&ds, ep, i);
+      }
+    }
+    // New sockets in --display-dir; a server that is not listening yet is
+    // retried a few times.
+    if (rescan) {
+      retry_scan = display_set_scan(&ds, &sh, &tf, ep, &dir) && --scan_retries > 0;
+    }
+    if (ds.count == 0 && !display_dir) {
+      fprintf(stderr, "No display left\n");
+      fatal = true;
+      break;
+    }
+    stats_stage(&st, STAT_EVENTS, ts);
 
-      cairo_text_extents_t te;
-      cairo_text_extents(measure_cr, dispbuf, &te);
+    // Suspend while invisible: once no display can be seen, disarm both
+    // timers so the process sleeps until an event. On resume, re-sync once
+    // with the current time.
+    bool all_suspended = true;
+    for (size_t i = 0; i < ds.n_slots; ++i) {
+      if (ds.slot[i]) all_suspended &= display_idle_update(ds.slot[i], &opt);
+    }
+    if (all_suspended != suspended) {
+      suspended = all_suspended;
+      tick_at = (struct timespec){0};  // re-armed by the next frame
+      if (suspended) {
+        timerfd_settime(tfd, 0, &(struct itimerspec){0}, NULL);
+        fade_timer_arm(fade_fd, 0);
+        ahead_pending = false;
+        display_set_drop_ahead(&ds);
+      }
+    }
+    if (suspended) continue;
 
-      cairo_font_extents_t fe;
-      cairo_font_extents(measure_cr, &fe);
+    if (ahead_pending) {
+      // Between a frame painted ahead and its boundary no new frame is
+      // started; what wants one waits for the boundary. Expose is still
+      // served, from the back buffers: they hold what is on screen.
+      for (size_t i = 0; i < ds.n_slots; ++i) {
+        display_t *d = ds.slot[i];
+        if (!d) continue;
+        display_present_exposed(d);
+        xcb_flush(d->c);
+      }
+      continue;
+    }
 
-      int text_w = (int)(te.x_advance + 0.5);
-      int text_h = (int)(fe.ascent + fe.descent + 0.5);
+    size_t n_frame = 0, n_ov = 0;
+    for (size_t i = 0; i < ds.n_slots; ++i) {
+      display_t *d = ds.slot[i];
+      if (!d) continue;
+      d->in_frame = d->need_redraw && d->fonts_ready && !d->idle.suspended;
+      if (d->held && !d->in_frame) display_invalidate(d);  // not presented on time
+      if (d->in_frame) {
+        n_frame++;
+        n_ov += d->n_ov;
+      }
+    }
+    if (n_frame == 0) continue;
 
-      uint16_t pad = (uint16_t)(opt.margin_px);
-      uint16_t win_w = (uint16_t)(text_w + pad * 2);
-      uint16_t win_h = (uint16_t)(text_h + pad * 2);
+    ts = stats_now(&st);
+    // Sample the clock once; flash logic and text use the same second. A
+    // render-ahead frame is formatted for its boundary instead, unless
+    // the wakeup came too late for that.
+    struct timespec rt;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    int64_t now_ns = mono_now_ns();
+    if (ahead_frame) {
+      int64_t early_ns = ts_diff_ns(&tick_deadline, &rt);
+      ahead_frame = early_ns > 0;
+      if (ahead_frame) {
+        rt = tick_deadline;
+        now_ns += early_ns;
+      }
+    }
+    // Frames painted ahead show their boundary's second; a boundary wakeup
+    // a second late repaints them.
+    if (ahead_boundary && rt.tv_sec != tick_deadline.tv_sec) display_set_drop_ahead(&ds);
+    time_t now = rt.tv_sec;
+    struct tm lt;
+#ifdef HAVE_CAIRO
+    // A --zone transition lookup switches TZ, which fontconfig on the font
+    // worker may be reading; take a load still running first.
+    if (fontload_fd(&sh.fl) >= 0 && timefmt_zones_due(&tf, now) && !font_load_done(&sh, &ds, ep)) {
+      fatal = true;
+      break;
+    }
+#endif
+    const char *nowstr = timefmt_update(&tf, &rt, flash.count, &lt);
+    status_update(&status, &rt);
+    struct timespec next_tick;
+    if (ahead_frame) {
+      // The boundary's own wakeup presents; it arms the next tick.
+      tick_timer_arm(tfd, &tick_deadline);
+    } else if (!tick_next(&tf, &status, &opt, &lt, &rt, sh.paced, &next_tick)) {
+      if (tick_at.tv_sec) timerfd_settime(tfd, 0, &(struct itimerspec){0}, NULL);
+      tick_at = (struct timespec){0};
+    } else if (next_tick.tv_sec != tick_at.tv_sec || next_tick.tv_nsec != tick_at.tv_nsec) {
+      struct timespec wake = sh.ahead_on ? ts_add_ns(next_tick, -sh.lead_ns) : next_tick;
+      tick_timer_arm(tfd, &wake);
+      tick_at = next_tick;
+    }
+    int64_t t_format = stats_now(&st);
+    int64_t format_ns = t_format - ts;  // plus composing, below
 
-      int16_t new_x = (int16_t)((int)screen->width_in_pixels - (int)win_w - (int)opt.margin_px);
-      int16_t new_y = (int16_t)opt.margin_px;
+    bool was_active = flash.active;
+    uint64_t flashes = flash.count;
+    flash_update(&flash, &opt, &lt, now, now_ns);
+    if (flash.active || was_active) {
+      fade_timer_arm(fade_fd, flash_next_deadline(&flash, &fade, now_ns));
+    }
+    if (tf.has_flash && flash.count != flashes) nowstr = timefmt_update(&tf, &rt, flash.count, NULL);
+    if (budget_wait && flash.count != flashes) {
+      stats_reset(&st);
+      exit_at_ns = mono_now_ns() + exit_after_s * NS_PER_SEC;
+      budget_wait = false;
+    }
+    // With a flash layer the overlay itself keeps its normal colors.
+    const flash_state_t no_flash = {0};
+    size_t step;
+    const colors_t flashed = flash_colors(&flash, &fade, &opt, now_ns, &step);
+    const colors_t plain = flash_colors(&no_flash, &fade, &opt, now_ns, &(size_t){0});
+    ts = stats_stage(&st, STAT_FLASH, t_format);
 
-      uint32_t cfg[5];
-      uint16_t mask = 0;
-      int cidx = 0;
-      mask |= XCB_CONFIG_WINDOW_X;      cfg[cidx++] = (uint32_t)new_x;
-      mask |= XCB_CONFIG_WINDOW_Y;      cfg[cidx++] = (uint32_t)new_y;
-      mask |= XCB_CONFIG_WINDOW_WIDTH;  cfg[cidx++] = (uint32_t)win_w;
-      mask |= XCB_CONFIG_WINDOW_HEIGHT; cfg[cidx++] = (uint32_t)win_h;
-      mask |= XCB_CONFIG_WINDOW_STACK_MODE; cfg[cidx++] = XCB_STACK_MODE_ABOVE;
-      xcb_configure_window(cconn, win, mask, cfg);
+    // Compose display string: the clock, then the status segments
+    char dispbuf[FRAME_TEXT_MAX];
+    status_flash(&status, opt.show_flash_count ? flash.count : 0);
+    snprintf(dispbuf, sizeof(dispbuf), "%s", nowstr);
+    status_append(&status, dispbuf, sizeof(dispbuf));
+    if (st.enabled) {
+      int64_t t = mono_now_ns();
+      stats_add(&st, STAT_FORMAT, (uint64_t)(format_ns + (t - ts)));
+      ts = t;
+    }
 
-      // Compute colors:
-      // - Normal: use configured fg/bg.
-      // - Flash: background fades from inverted(orig_bg) -> orig_bg over 30s;
-      //          foreground is always inverse of CURRENT background.
-      double fg_r = opt.fg_r, fg_g = opt.fg_g, fg_b = opt.fg_b;
-      double bg_r = opt.bg_r, bg_g = opt.bg_g, bg_b = opt.bg_b;
+    for (size_t i = 0; i < ds.n_slots; ++i) {
+      display_t *d = ds.slot[i];
+      if (!d || !d->in_frame || d->held || (ahead_frame && !d->ahead)) continue;
+      painter_layout(&d->painter, dispbuf, &d->last, &d->cur);
+      d->cur.colors = d->layer.enabled ? plain : flashed;
+    }
+    ts = stats_stage(&st, STAT_MEASURE, ts);
 
+    if (opt.debug) {
       if (flash.active) {
-        double elapsed = difftime(now, flash.start);
-        double p = elapsed / (double)FLASH_DURATION_SEC; // 0 -> 1
-        if (p < 0.0) {
-          if (opt.debug) fprintf(stderr, "[debug] clamp p<0: %.6f\n", p);
-          p = 0.0;
-        } else if (p > 1.0) {
-          if (opt.debug) fprintf(stderr, "[debug] clamp p>1: %.6f\n", p);
-          p = 1.0;
-        }
-
-        double inv_bg_r = 1.0 - opt.bg_r, inv_bg_g = 1.0 - opt.bg_g, inv_bg_b = 1.0 - opt.bg_b;
-
-        bg_r = inv_bg_r * (1.0 - p) + opt.bg_r * p;
-        bg_g = inv_bg_g * (1.0 - p) + opt.bg_g * p;
-        bg_b = inv_bg_b * (1.0 - p) + opt.bg_b * p;
-
-        fg_r = 1.0 - bg_r;
-        fg_g = 1.0 - bg_g;
-        fg_b = 1.0 - bg_b;
+        fprintf(stderr, "[debug] flash tick: step=%zu/%zu bg=%.3f,%.3f,%.3f fg(inv)=%.3f,%.3f,%.3f disp=\"%s\"\n",
+                step, fade.n, flashed.bg_r, flashed.bg_g, flashed.bg_b, flashed.fg_r, flashed.fg_g, flashed.fg_b,
+                dispbuf);
+      } else {
+        fprintf(stderr, "[debug] tick disp=\"%s\" displays=%zu overlays=%zu flash=%d count=%llu\n",
+                dispbuf, n_frame, n_ov, flash.active, (unsigned long long)flash.count);
+      }
+    }
 
-        if (opt.debug) {
-          fprintf(stderr, "[debug] flash tick: p=%.3f bg=%.3f,%.3f,%.3f fg(inv)=%.3f,%.3f,%.3f disp=\"%s\"\n",
-                  p, bg_r, bg_g, bg_b, fg_r, fg_g, fg_b, dispbuf);
+    // One paint into each display's back buffer serves all its overlays.
+    // Frames rendered ahead are painted and flushed now, so their servers
+    // rasterize during the lead, and held in their display until the
+    // boundary's wakeup presents them; the others are painted then.
+    if (ahead_frame) {
+      for (size_t i = 0; i < ds.n_slots; ++i) {
+        display_t *d = ds.slot[i];
+        if (!d || !d->in_frame || !d->ahead) continue;
+        if (!display_paint(d, &opt, true)) {
+          display_set_close(&ds, ep, i);
+          continue;
         }
+        d->held = true;
+        xcb_flush(d->c);
       }
-
-      if (opt.debug && !flash.active) {
-        fprintf(stderr, "[debug] tick disp=\"%s\" text_w=%d text_h=%d win=%ux%u at (%d,%d) flash=%d count=%llu\n",
-                dispbuf, text_w, text_h, win_w, win_h, new_x, new_y, flash.active,
-                (unsigned long long)flash_count);
+      ahead_pending = true;
+      ahead_paint_ns = st.enabled ? mono_now_ns() - ts : 0;
+      if (opt.debug) {
+        struct timespec ready;
+        clock_gettime(CLOCK_REALTIME, &ready);
+        fprintf(stderr, "[debug] render-ahead: frame ready %.3f ms before the boundary\n",
+                (double)ts_diff_ns(&tick_deadline, &ready) / 1e6);
       }
+      continue;
+    }
+    for (size_t i = 0; i < ds.n_slots; ++i) {
+      display_t *d = ds.slot[i];
+      if (!d || !d->in_frame || d->held) continue;
+      if (!display_paint(d, &opt, false)) display_set_close(&ds, ep, i);
+    }
+    int64_t paint_ns = ahead_paint_ns + (st.enabled ? mono_now_ns() - ts : 0);
+    ahead_paint_ns = 0;
+    ts = stats_now(&st);
 
-      // Create drawing surface for this window size
-      cairo_surface_t *surface = cairo_xcb_surface_create(cconn, win, visual, win_w, win_h);
-      cairo_t *cr = cairo_create(surface);
-
-      // Background
-      cairo_set_source_rgb(cr, bg_r, bg_g, bg_b);
-      cairo_paint(cr);
-
-      // Text
-      cairo_select_font_face(cr, opt.font_family, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-      cairo_set_font_size(cr, opt.font_size_px);
-      cairo_set_source_rgb(cr, fg_r, fg_g, fg_b);
-
-      double text_x = pad - te.x_bearing;     // account for left bearing
-      double text_y = pad + fe.ascent;        // baseline
+    for (size_t i = 0; i < ds.n_slots; ++i) {
+      if (ds.slot[i] && ds.slot[i]->in_frame) display_configure(ds.slot[i], &opt);
+    }
+    ts = stats_stage(&st, STAT_CONFIGURE, ts);
 
-      cairo_move_to(cr, text_x, text_y);
-      cairo_show_text(cr, dispbuf);
-      cairo_surface_flush(surface);
-      cairo_destroy(cr);
-      cairo_surface_destroy(surface);
+    int64_t requests = 0;
+    uint64_t round_trips = 0, events = 0;
+    bool counted = false;
+    for (size_t i = 0; i < ds.n_slots; ++i) {
+      display_t *d = ds.slot[i];
+      if (!d) continue;
+      // Events and waits of displays without a frame belong to this tick too.
+      round_trips += display_round_trips(d);
+      events += d->events;
+      d->events = 0;
+      if (!d->in_frame) continue;
+      display_present(d, &opt, &flash, &fade, now_ns);
+      if (st.enabled) {
+        int64_t n = display_requests(d);
+        if (n >= 0) {
+          requests += n;
+          counted = true;
+        }
+      }
+    }
+    if (st.enabled) {
+      if (counted) stats_add(&st, STAT_REQUESTS, (uint64_t)requests);
+      stats_add(&st, STAT_ROUND_TRIPS, round_trips);
+      stats_add(&st, STAT_XEVENTS, events);
+      st.x_events += events;
+      st.ticks++;
+      int64_t t = mono_now_ns();
+      stats_add(&st, STAT_PAINT, (uint64_t)(paint_ns + (t - ts)));  // with the paint done ahead
+      ts = t;
+    }
 
-      xcb_flush(cconn);
-      strncpy(last_str, dispbuf, sizeof(last_str)-1);
-      last_str[sizeof(last_str)-1] = '\0';
+    for (size_t i = 0; i < ds.n_slots; ++i) {
+      display_t *d = ds.slot[i];
+      if (!d || !d->in_frame) continue;
+      if (sh.paced && d->n_ov) {
+        // Ask for the next vblank; its completion brings the next frame.
+        vsync_target(&d->vs, d->c, d->ovs[0].win);
+        vsync_request(&d->vs, d->c);
+      }
+      xcb_flush(d->c);
+      d->last = d->cur;
+      d->need_redraw = false;
+      d->held = false;
+    }
+    stats_stage(&st, STAT_FLUSH, ts);
+    if (st.enabled) {
+      int64_t written = stats_bytes_written(&st);
+      if (written >= 0) stats_add(&st, STAT_BYTES, (uint64_t)written);
+    }
+    if (st.enabled && boundary_tick) {
+      struct timespec done;
+      clock_gettime(CLOCK_REALTIME, &done);
+      int64_t late = ts_diff_ns(&done, &tick_deadline);
+      stats_add(&st, STAT_LATENCY, (uint64_t)late);
+    }
+    if (first_frame) {
+      startup_mark(&opt, t0_ns, "first frame");
+      first_frame = false;
     }
   }
 
-  // Unreachable in normal usage; kept for completeness
-  cairo_destroy(measure_cr);
-  cairo_surface_destroy(measure_surface);
-  xcb_disconnect(cconn);
-  return 0;
+  // Only reached on a fatal error or after --exit-after
+  bool over_budget = false;
+  if (!fatal && exit_at_ns && st.enabled) {
+    stats_dump_displays(&st, &ds);
+    if (budget) over_budget = !stats_check_budget(&st, budget_requests, budget_bytes);
+  }
+  for (size_t i = 0; i < ds.n_slots; ++i) {
+    if (ds.slot[i]) display_set_close(&ds, ep, i);
+  }
+#ifdef HAVE_CAIRO
+  fontload_finish(&sh.fl);
+  render_destroy(&sh.pending);
+  render_destroy(&sh.master);
+#endif
+  displaydir_destroy(&dir);
+  control_close(&ctl);
+  close(tfd);
+  close(fade_fd);
+  if (sig_fd >= 0) close(sig_fd);
+  close(ep);
+  status_destroy(&status);
+  timefmt_destroy(&tf);
+  return fatal ? 1 : over_budget ? 3 : 0;
 }
@@ -0,0 +1,110 @@
+// outputs: active monitors from RandR. See outputs.h.
+#define _POSIX_C_SOURCE 200809L
+#include "outputs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool outputs_init(outputs_t *o, xcb_connection_t *c, xcb_window_t root) {
+  memset(o, 0, sizeof(*o));
+  const xcb_query_extension_reply_t *ext = xcb_get_extension_data(c, &xcb_randr_id);
+  if (!ext || !ext->present) return false;
+  xcb_randr_query_version_reply_t *v = xcb_randr_query_version_reply(c, xcb_randr_query_version(c, 1, 3), NULL);
+  bool ok = v && (v->major_version > 1 || (v->major_version == 1 && v->minor_version >= 3));
+  free(v);
+  if (!ok) return false;
+  o->present = true;
+  o->first_event = ext->first_event;
+  xcb_randr_select_input(c, root, XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE |
+                                  XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE |
+                                  XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE);
+  return true;
+}
+
+// Whether name is one of the comma-separated entries of list.
+static bool name_listed(const char *list, const char *name) {
+  size_t n = strlen(name);
+  for (const char *p = list; *p; ) {
+    const char *end = strchr(p, ',');
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+    if (len == n && strncmp(p, name, n) == 0) return true;
+    if (!end) break;
+    p = end + 1;
+  }
+  return false;
+}
+
+size_t outputs_query(const outputs_t *o, xcb_connection_t *c, xcb_window_t root,
+                     const char *select, output_area_t out[OUTPUTS_MAX]) {
+  if (!o->present) return 0;
+  bool all = strcmp(select, "all") == 0;
+  bool primary_only = strcmp(select, "primary") == 0;
+
+  xcb_randr_get_output_primary_cookie_t pck = {0};
+  if (primary_only) pck = xcb_randr_get_output_primary(c, root);
+  xcb_randr_get_screen_resources_current_reply_t *res =
+    xcb_randr_get_screen_resources_current_reply(c, xcb_randr_get_screen_resources_current(c, root), NULL);
+  if (!res) return 0;
+  xcb_randr_output_t primary = 0;
+  if (primary_only) {
+    xcb_randr_get_output_primary_reply_t *pr = xcb_randr_get_output_primary_reply(c, pck, NULL);
+    if (pr) primary = pr->output;
+    free(pr);
+  }
+
+  xcb_randr_output_t *ids = xcb_randr_get_screen_resources_current_outputs(res);
+  int n_ids = xcb_randr_get_screen_resources_current_outputs_length(res);
+  if (n_ids > 64) n_ids = 64;
+  xcb_randr_get_output_info_cookie_t ock[64];
+  for (int i = 0; i < n_ids; ++i) ock[i] = xcb_randr_get_output_info(c, ids[i], res->config_timestamp);
+
+  // Selected, connected outputs with a CRTC; one entry per CRTC (clones
+  // share one overlay).
+  size_t n = 0;
+  for (int i = 0; i < n_ids; ++i) {
+    xcb_randr_get_output_info_reply_t *oi = xcb_randr_get_output_info_reply(c, ock[i], NULL);
+    if (!oi) continue;
+    char name[OUTPUT_NAME_MAX];
+    int len = xcb_randr_get_output_info_name_length(oi);
+    if (len >= OUTPUT_NAME_MAX) len = OUTPUT_NAME_MAX - 1;
+    memcpy(name, xcb_randr_get_output_info_name(oi), (size_t)len);
+    name[len] = '\0';
+    bool wanted = all || (primary_only ? ids[i] == primary : name_listed(select, name));
+    if (wanted && oi->connection == XCB_RANDR_CONNECTION_CONNECTED && oi->crtc) {
+      bool dup = false;
+      for (size_t k = 0; k < n; ++k) dup |= out[k].crtc == oi->crtc;
+      if (!dup && n < OUTPUTS_MAX) {
+        memset(&out[n], 0, sizeof(out[n]));
+        out[n].crtc = oi->crtc;
+        memcpy(out[n].name, name, (size_t)len + 1);
+        n++;
+      }
+    }
+    free(oi);
+  }
+
+  xcb_randr_get_crtc_info_cookie_t cck[OUTPUTS_MAX];
+  for (size_t k = 0; k < n; ++k) cck[k] = xcb_randr_get_crtc_info(c, out[k].crtc, res->config_timestamp);
+  size_t m = 0;
+  for (size_t k = 0; k < n; ++k) {
+    xcb_randr_get_crtc_info_reply_t *ci = xcb_randr_get_crtc_info_reply(c, cck[k], NULL);
+    if (ci && ci->mode && ci->width && ci->height) {
+      out[m] = out[k];
+      out[m].x = ci->x;
+      out[m].y = ci->y;
+      out[m].w = ci->width;
+      out[m].h = ci->height;
+      m++;
+    }
+    free(ci);
+  }
+  free(res);
+  return m;
+}
+
+bool outputs_is_change(const outputs_t *o, const xcb_generic_event_t *ev) {
+  if (!o->present) return false;
+  uint8_t rt = ev->response_type & ~0x80;
+  return rt == o->first_event + XCB_RANDR_SCREEN_CHANGE_NOTIFY ||
+         rt == o->first_event + XCB_RANDR_NOTIFY;
+}
@@ -0,0 +1,43 @@
+// outputs: active monitors from RandR, for --outputs (one overlay per CRTC).
+#ifndef OUTPUTS_H
+#define OUTPUTS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <xcb/xcb.h>
+#include <xcb/randr.h>
+
+#define OUTPUTS_MAX 16
+#define OUTPUT_NAME_MAX 32
+
+// The rectangle of one active CRTC, named after its first selected output.
+typedef struct {
+  xcb_randr_crtc_t crtc;
+  int16_t x, y;
+  uint16_t w, h;
+  char name[OUTPUT_NAME_MAX];
+} output_area_t;
+
+typedef struct {
+  bool present;         // RandR >= 1.3 available
+  uint8_t first_event;
+} outputs_t;
+
+// Checks for RandR 1.3 and selects screen/CRTC/output change events on root.
+// The extension data must have been prefetched for this to not block twice.
+bool outputs_init(outputs_t *o, xcb_connection_t *c, xcb_window_t root);
+
+// Lists the active CRTCs showing a selected output into out (at most
+// OUTPUTS_MAX). select is "all", "primary" or a comma-separated list of
+// output names. All per-output and per-CRTC queries are pipelined, so it
+// waits for replies OUTPUTS_QUERY_ROUND_TRIPS times.
+#define OUTPUTS_QUERY_ROUND_TRIPS 3
+size_t outputs_query(const outputs_t *o, xcb_connection_t *c, xcb_window_t root,
+                     const char *select, output_area_t out[OUTPUTS_MAX]);
+
+// True for events that can change the monitor layout.
+bool outputs_is_change(const outputs_t *o, const xcb_generic_event_t *ev);
+
+#endif
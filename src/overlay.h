@@ -0,0 +1,63 @@
+// Shared definitions for x11-datetime-overlay.
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define NS_PER_SEC 1000000000LL
+#define NS_PER_MS  1000000LL
+
+// Where frames are rasterized before they reach the window.
+typedef enum {
+  BACKEND_XCB,  // Cairo xcb surface on a server-side pixmap
+  BACKEND_SHM,  // Cairo image surface in MIT-SHM, presented with ShmPutImage
+  BACKEND_XRENDER, // A8 text mask on the server, composited with XRender
+  BACKEND_BITMAP,  // built-in bitmap font uploaded with PutImage; no cairo
+} backend_t;
+
+// Who animates the flash fade.
+typedef enum {
+  FLASH_MODE_CLIENT,      // repaint every fade step with the faded colors
+  FLASH_MODE_COMPOSITOR,  // inverted layer window faded by _NET_WM_WINDOW_OPACITY
+} flash_mode_t;
+
+// Sub-second digits for --precision.
+typedef enum {
+  PRECISION_NONE,
+  PRECISION_CS,  // centiseconds, %{cs}
+  PRECISION_MS,  // milliseconds, %{ms}
+} precision_t;
+
+typedef struct {
+  const char *font_family;
+  double font_size_px;
+  uint32_t margin_px;
+  double fg_r, fg_g, fg_b;
+  double bg_r, bg_g, bg_b;
+  bool time_only;
+  const char *format;  // --format template; NULL: the default for time_only
+  bool debug;
+  int flash_minutes; // 0 disables
+  bool show_flash_count;
+  flash_mode_t flash_mode;
+  backend_t backend;
+  const char *outputs; // --outputs selection; NULL: one overlay for the whole root
+  precision_t precision;
+  int render_ahead_ms;  // lead of --render-ahead; 0 renders at the boundary
+  bool atlas_cache;     // reuse rasterized atlases across runs (render.h)
+} options_t;
+
+typedef struct {
+  double fg_r, fg_g, fg_b;
+  double bg_r, bg_g, bg_b;
+} colors_t;
+
+static inline int64_t mono_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,543 @@
+// render: font cache, glyph atlas and damage-tracked painting. See render.h.
+#define _POSIX_C_SOURCE 200809L
+#include "render.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static bool font_cache_init(font_cache_t *f, const char *family, double size_px, const char *alphabet) {
+  memset(f, 0, sizeof(*f));
+  cairo_font_face_t *face = cairo_toy_font_face_create(family, CAIRO_FONT_SLANT_NORMAL,
+                                                       CAIRO_FONT_WEIGHT_NORMAL);
+  cairo_matrix_t font_matrix, ctm;
+  cairo_matrix_init_scale(&font_matrix, size_px, size_px);
+  cairo_matrix_init_identity(&ctm);
+  cairo_font_options_t *fo = cairo_font_options_create();
+  f->scaled = cairo_scaled_font_create(face, &font_matrix, &ctm, fo);
+  cairo_font_options_destroy(fo);
+  cairo_font_face_destroy(face);
+  if (cairo_scaled_font_status(f->scaled) != CAIRO_STATUS_SUCCESS) {
+    cairo_scaled_font_destroy(f->scaled);
+    f->scaled = NULL;
+    return false;
+  }
+  cairo_scaled_font_extents(f->scaled, &f->fe);
+
+  f->monospace = true;
+  for (size_t i = 0; alphabet[i]; ++i) {
+    char s[2] = { alphabet[i], '\0' };
+    cairo_text_extents_t te;
+    cairo_scaled_font_text_extents(f->scaled, s, &te);
+    if (i == 0) f->mono_advance = te.x_advance;
+    else if (te.x_advance != f->mono_advance) f->monospace = false;
+  }
+  return true;
+}
+
+// Rasterizes the alphabet into a->image, client side: no X connection is
+// involved, so this can run off the main thread.
+static bool atlas_rasterize(glyph_atlas_t *a, const font_cache_t *font, const char *alphabet) {
+  memset(a, 0, sizeof(*a));
+
+  const cairo_font_extents_t fe = font->fe;
+  a->ascent = fe.ascent;
+  a->descent = fe.descent;
+
+  size_t n = strlen(alphabet);
+  double max_adv = 0.0, overhang = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    char s[2] = { alphabet[i], '\0' };
+    cairo_text_extents_t te;
+    cairo_scaled_font_text_extents(font->scaled, s, &te);
+    atlas_glyph_t *g = &a->glyphs[(unsigned char)alphabet[i]];
+    g->x_advance = te.x_advance;
+    g->x_bearing = te.x_bearing;
+    if (te.x_advance > max_adv) max_adv = te.x_advance;
+    if (-te.x_bearing > overhang) overhang = -te.x_bearing;
+    if (te.x_bearing + te.width - te.x_advance > overhang) overhang = te.x_bearing + te.width - te.x_advance;
+  }
+
+  a->pad_x = (int)overhang + 1;
+  a->pad_y = 1;
+  a->cell_w = (int)(max_adv + 0.999) + a->pad_x * 2;
+  a->cell_h = (int)(fe.ascent + fe.descent + 0.999) + a->pad_y * 2;
+
+  a->image = cairo_image_surface_create(CAIRO_FORMAT_A8, a->cell_w * (int)n, a->cell_h);
+  if (cairo_surface_status(a->image) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(a->image);
+    a->image = NULL;
+    return false;
+  }
+
+  cairo_t *cr = cairo_create(a->image);
+  cairo_set_scaled_font(cr, font->scaled);
+  cairo_set_source_rgba(cr, 0, 0, 0, 1);
+  for (size_t i = 0; i < n; ++i) {
+    char s[2] = { alphabet[i], '\0' };
+    atlas_glyph_t *g = &a->glyphs[(unsigned char)alphabet[i]];
+    g->cell_x = (int)i * a->cell_w;
+    cairo_move_to(cr, g->cell_x + a->pad_x, a->pad_y + a->ascent);
+    cairo_show_text(cr, s);
+    g->present = true;
+  }
+  cairo_destroy(cr);
+  cairo_surface_flush(a->image);
+  return true;
+}
+
+// Creates the atlas surface similar to `like` and copies src into it.
+static bool atlas_upload(glyph_atlas_t *a, cairo_surface_t *like, cairo_surface_t *src, int w, int h) {
+  a->surface = cairo_surface_create_similar(like, CAIRO_CONTENT_ALPHA, w, h);
+  if (cairo_surface_status(a->surface) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(a->surface);
+    a->surface = NULL;
+    return false;
+  }
+  cairo_t *cr = cairo_create(a->surface);
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_surface(cr, src, 0, 0);
+  cairo_paint(cr);
+  cairo_destroy(cr);
+  cairo_surface_flush(a->surface);
+  return true;
+}
+
+static bool atlas_covers(const glyph_atlas_t *a, const char *s) {
+  if (!a->surface) return false;
+  for (; *s; ++s) {
+    unsigned char ch = (unsigned char)*s;
+    if (ch >= 128 || !a->glyphs[ch].present) return false;
+  }
+  return true;
+}
+
+static double atlas_text_advance(const glyph_atlas_t *a, const char *s) {
+  double adv = 0.0;
+  for (; *s; ++s) adv += a->glyphs[(unsigned char)*s].x_advance;
+  return adv;
+}
+
+// Left edge of cell i of s, as a whole-pixel offset from the pen origin x.
+// The monospace table holds these precomputed; otherwise advances are
+// summed from the start of the string.
+static int pen_offset(const render_t *r, double x, const char *s, size_t i) {
+  if (r->mono.enabled) return (int)(x + 0.5) + r->mono.pen[i];
+  double pen = x;
+  for (size_t k = 0; k < i; ++k) pen += r->atlas.glyphs[(unsigned char)s[k]].x_advance;
+  return (int)(pen + 0.5);
+}
+
+// Draws s with its baseline starting at (x, y) using the current source.
+// Pen positions are rounded to whole pixels so every cell copy is aligned.
+// Only cells intersecting the column span [x0, x1) are drawn; callers clip
+// to the same span when repainting part of a line.
+static void atlas_show_text(const render_t *r, cairo_t *cr, double x, double y, const char *s,
+                            int x0, int x1) {
+  const glyph_atlas_t *a = &r->atlas;
+  int top = (int)(y - a->ascent + 0.5) - a->pad_y;
+  double pen = x;
+  for (size_t i = 0; s[i]; ++i) {
+    const atlas_glyph_t *g = &a->glyphs[(unsigned char)s[i]];
+    int dst_x = (r->mono.enabled ? (int)(x + 0.5) + r->mono.pen[i] : (int)(pen + 0.5)) - a->pad_x;
+    if (s[i] != ' ' && dst_x < x1 && dst_x + a->cell_w > x0) {
+      cairo_save(cr);
+      cairo_rectangle(cr, dst_x, top, a->cell_w, a->cell_h);
+      cairo_clip(cr);
+      cairo_mask_surface(cr, a->surface, dst_x - g->cell_x, top);
+      cairo_restore(cr);
+    }
+    pen += g->x_advance;
+  }
+}
+
+// Column span [*x0, *x1) touched by the atlas cells of s[first..last] when s
+// is drawn with its pen starting at x.
+static void atlas_cell_span(const render_t *r, double x, const char *s,
+                            size_t first, size_t last, int *x0, int *x1) {
+  const glyph_atlas_t *a = &r->atlas;
+  *x0 = pen_offset(r, x, s, first) - a->pad_x;
+  *x1 = pen_offset(r, x, s, last) - a->pad_x + a->cell_w;
+}
+
+// Compares two equal-length strings; returns false if they are identical,
+// otherwise stores the indices of the first and last differing characters.
+static bool diff_cells(const char *prev, const char *cur, size_t *first, size_t *last) {
+  size_t n = strlen(cur);
+  size_t i = 0;
+  while (i < n && prev[i] == cur[i]) ++i;
+  if (i == n) return false;
+  size_t j = n - 1;
+  while (j > i && prev[j] == cur[j]) --j;
+  *first = i;
+  *last = j;
+  return true;
+}
+
+// Fills the monospace layout table for an origin at x_bearing.
+static void mono_layout_fill(mono_layout_t *m, const font_cache_t *font, double x_bearing, uint32_t pad) {
+  memset(m, 0, sizeof(*m));
+  if (!font->monospace) return;
+  m->x_bearing = x_bearing;
+  for (size_t n = 0; n <= FRAME_TEXT_MAX; ++n) m->pen[n] = (int)((double)n * font->mono_advance + 0.5);
+  for (size_t n = 0; n < FRAME_TEXT_MAX; ++n) m->w[n] = (uint16_t)(m->pen[n] + pad * 2);
+  m->h = (uint16_t)((int)(font->fe.ascent + font->fe.descent + 0.5) + pad * 2);
+  m->enabled = true;
+}
+
+// Fills the monospace layout table. The origin uses the smallest left
+// bearing in the alphabet, rounded down, so it stays on a whole pixel and
+// does not move when the first character changes.
+static void mono_layout_init(mono_layout_t *m, const font_cache_t *font, const char *alphabet,
+                             uint32_t pad) {
+  double bearing = 0.0;
+  for (size_t i = 0; font->monospace && alphabet[i]; ++i) {
+    char s[2] = { alphabet[i], '\0' };
+    cairo_text_extents_t te;
+    cairo_scaled_font_text_extents(font->scaled, s, &te);
+    if (i == 0 || te.x_bearing < bearing) bearing = te.x_bearing;
+  }
+  mono_layout_fill(m, font, floor(bearing), pad);
+}
+
+// On-disk atlas: this header, the key text (padded to 8 bytes), then the A8
+// pixels. Native layout and byte order: the magic and header_size reject
+// files from another build, the key rejects hash collisions.
+#define ATLAS_FILE_MAGIC "XDOATL01"
+
+typedef struct {
+  char magic[8];
+  uint32_t header_size;
+  uint32_t key_len;
+  uint32_t pixels_off;
+  int32_t width, height, stride;
+  cairo_font_extents_t fe;
+  uint8_t monospace;
+  double mono_advance;
+  double mono_x_bearing;
+  int32_t cell_w, cell_h, pad_x, pad_y;
+  double ascent, descent;
+  atlas_glyph_t glyphs[128];
+} atlas_file_t;
+
+// Latest mtime of the fontconfig caches and configuration: fc-cache runs
+// (and so one of these changes) whenever fonts are installed or removed,
+// which is when a cached rasterization may no longer match the font.
+static long long fontconfig_stamp(void) {
+  char user[512] = "";
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  if (xdg && xdg[0] == '/') snprintf(user, sizeof(user), "%s/fontconfig", xdg);
+  else if (home) snprintf(user, sizeof(user), "%s/.cache/fontconfig", home);
+  const char *paths[] = { "/var/cache/fontconfig", "/etc/fonts", "/etc/fonts/conf.d", user };
+  long long stamp = 0;
+  for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+    struct stat sb;
+    if (paths[i][0] && stat(paths[i], &sb) == 0 && (long long)sb.st_mtime > stamp) stamp = (long long)sb.st_mtime;
+  }
+  return stamp;
+}
+
+static void atlas_cache_key(render_t *r) {
+  atlas_cache_t *c = &r->cache;
+  snprintf(c->key, sizeof(c->key), "family=%s\nsize=%.3f\nalphabet=%s\ncairo=%s\nfontconfig=%lld\n",
+           r->family, r->size_px, r->alphabet, cairo_version_string(), fontconfig_stamp());
+  char name[64];
+  snprintf(name, sizeof(name), "atlas-%016llx.bin", cachefile_hash(c->key));
+  if (!cachefile_path(name, c->path, sizeof(c->path))) c->path[0] = '\0';
+}
+
+// Whether the metrics of a header that matched the key describe cells
+// inside its pixels: a stale or damaged file must not produce frame sizes
+// or glyph sources from garbage.
+static bool atlas_header_sane(const atlas_file_t *h, const char *alphabet) {
+  if (h->cell_w <= 0 || h->cell_h <= 0 || h->cell_w > h->width || h->cell_h > h->height ||
+      h->pad_x < 0 || h->pad_y < 0 || h->pad_x * 2 >= h->cell_w || h->pad_y * 2 >= h->cell_h) {
+    return false;
+  }
+  for (const char *p = alphabet; *p; ++p) {
+    if ((unsigned char)*p >= 128 || !h->glyphs[(unsigned char)*p].present) return false;
+  }
+  for (size_t i = 0; i < 128; ++i) {
+    const atlas_glyph_t *g = &h->glyphs[i];
+    if (g->present && (g->cell_x < 0 || g->cell_x > h->width - h->cell_w)) return false;
+  }
+  return true;
+}
+
+// Maps the cache file and takes the font and atlas metrics from it, leaving
+// the pixels mapped for render_atlas_init.
+static bool atlas_cache_load(render_t *r) {
+  atlas_cache_t *c = &r->cache;
+  if (!c->path[0] || !cachefile_map(c->path, &c->map)) return false;
+  const atlas_file_t *h = c->map.addr;
+  size_t key_len = strlen(c->key);
+  bool ok = c->map.size >= sizeof(*h) && memcmp(h->magic, ATLAS_FILE_MAGIC, 8) == 0 &&
+            h->header_size == sizeof(*h) && h->key_len == key_len &&
+            h->pixels_off >= sizeof(*h) + key_len && h->width > 0 && h->height > 0 &&
+            h->stride == cairo_format_stride_for_width(CAIRO_FORMAT_A8, h->width) &&
+            c->map.size >= (size_t)h->pixels_off + (size_t)h->stride * (size_t)h->height &&
+            memcmp((const char *)h + sizeof(*h), c->key, key_len) == 0 &&
+            atlas_header_sane(h, r->alphabet);
+  if (!ok) {
+    cachefile_unmap(&c->map);
+    return false;
+  }
+
+  font_cache_t *f = &r->font;
+  f->scaled = NULL;
+  f->fe = h->fe;
+  f->monospace = h->monospace;
+  f->mono_advance = h->mono_advance;
+  glyph_atlas_t *a = &r->atlas;
+  a->cell_w = h->cell_w;
+  a->cell_h = h->cell_h;
+  a->pad_x = h->pad_x;
+  a->pad_y = h->pad_y;
+  a->ascent = h->ascent;
+  a->descent = h->descent;
+  memcpy(a->glyphs, h->glyphs, sizeof(a->glyphs));
+  mono_layout_fill(&r->mono, f, h->mono_x_bearing, r->pad);
+  c->pixels = (const uint8_t *)c->map.addr + h->pixels_off;
+  c->stride = h->stride;
+  c->hit = true;
+  return true;
+}
+
+// The prepared atlas as an image surface: the mapped cache pixels, or the
+// fresh rasterization. NULL if there is neither.
+static cairo_surface_t *atlas_source(const render_t *r) {
+  const atlas_cache_t *c = &r->cache;
+  if (c->map.addr) {
+    const atlas_file_t *h = c->map.addr;
+    return cairo_image_surface_create_for_data((unsigned char *)c->pixels, CAIRO_FORMAT_A8,
+                                               h->width, h->height, c->stride);
+  }
+  return r->atlas.image ? cairo_surface_reference(r->atlas.image) : NULL;
+}
+
+// Uploads r's prepared atlas into dst's atlas, similar to `like`.
+static bool atlas_upload_from(glyph_atlas_t *dst, const render_t *r, cairo_surface_t *like) {
+  cairo_surface_t *src = atlas_source(r);
+  if (!src) return false;
+  bool ok = atlas_upload(dst, like, src, cairo_image_surface_get_width(src), cairo_image_surface_get_height(src));
+  cairo_surface_destroy(src);
+  return ok;
+}
+
+// Writes the freshly rasterized atlas image with its metrics.
+static void atlas_cache_store(const render_t *r) {
+  const atlas_cache_t *c = &r->cache;
+  const glyph_atlas_t *a = &r->atlas;
+  cairo_surface_t *img = a->image;
+
+  atlas_file_t h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, ATLAS_FILE_MAGIC, 8);
+  size_t key_len = strlen(c->key);
+  h.header_size = sizeof(h);
+  h.key_len = (uint32_t)key_len;
+  h.pixels_off = (uint32_t)((sizeof(h) + key_len + 7) & ~(size_t)7);
+  h.width = cairo_image_surface_get_width(img);
+  h.height = cairo_image_surface_get_height(img);
+  h.stride = cairo_image_surface_get_stride(img);
+  h.fe = r->font.fe;
+  h.monospace = r->font.monospace;
+  h.mono_advance = r->font.mono_advance;
+  h.mono_x_bearing = r->mono.x_bearing;
+  h.cell_w = a->cell_w;
+  h.cell_h = a->cell_h;
+  h.pad_x = a->pad_x;
+  h.pad_y = a->pad_y;
+  h.ascent = a->ascent;
+  h.descent = a->descent;
+  memcpy(h.glyphs, a->glyphs, sizeof(h.glyphs));
+
+  static const char zeros[8];
+  const void *parts[] = { &h, c->key, zeros, cairo_image_surface_get_data(img) };
+  size_t sizes[] = { sizeof(h), key_len, h.pixels_off - sizeof(h) - key_len, (size_t)h.stride * (size_t)h.height };
+  if (!cachefile_write(c->path, parts, sizes, 4)) {
+    fprintf(stderr, "Could not write the atlas cache %s\n", c->path);
+  }
+}
+
+// Appends the printable ASCII characters of src not yet in out.
+static void alphabet_add(char *out, size_t size, const char *src) {
+  size_t n = strlen(out);
+  for (; *src && n + 1 < size; ++src) {
+    unsigned char ch = (unsigned char)*src;
+    if (ch < 0x20 || ch >= 0x7f || strchr(out, ch)) continue;
+    out[n++] = (char)ch;
+    out[n] = '\0';
+  }
+}
+
+bool render_init(render_t *r, const options_t *opt, const char *charset) {
+  memset(r, 0, sizeof(*r));
+  snprintf(r->family, sizeof(r->family), "%s", opt->font_family);
+  r->size_px = opt->font_size_px;
+  r->pad = opt->margin_px;
+  alphabet_add(r->alphabet, sizeof(r->alphabet), ATLAS_ALPHABET);
+  if (charset) alphabet_add(r->alphabet, sizeof(r->alphabet), charset);
+  if (opt->atlas_cache) {
+    atlas_cache_key(r);
+    if (atlas_cache_load(r)) return true;
+  }
+  if (!font_cache_init(&r->font, r->family, r->size_px, r->alphabet)) return false;
+  mono_layout_init(&r->mono, &r->font, r->alphabet, r->pad);
+  return true;
+}
+
+bool render_atlas_prepare(render_t *r) {
+  if (r->cache.map.addr || r->atlas.image) return true;
+  if (!atlas_rasterize(&r->atlas, &r->font, r->alphabet)) return false;
+  if (r->cache.path[0]) atlas_cache_store(r);
+  return true;
+}
+
+bool render_atlas_init(render_t *r, cairo_surface_t *like) {
+  if (!render_atlas_prepare(r)) return false;
+  bool ok = atlas_upload_from(&r->atlas, r, like);
+  cachefile_unmap(&r->cache.map);
+  r->cache.pixels = NULL;
+  if (r->atlas.image) cairo_surface_destroy(r->atlas.image);
+  r->atlas.image = NULL;
+  return ok;
+}
+
+bool render_share(render_t *dst, const render_t *src, cairo_surface_t *like) {
+  *dst = *src;
+  memset(&dst->cache.map, 0, sizeof(dst->cache.map));
+  dst->cache.pixels = NULL;
+  dst->atlas.image = NULL;
+  dst->atlas.surface = NULL;
+  if (dst->font.scaled) cairo_scaled_font_reference(dst->font.scaled);
+  return atlas_upload_from(&dst->atlas, src, like);
+}
+
+void render_set_pad(render_t *r, uint32_t pad) {
+  r->pad = pad;
+  if (r->mono.enabled) mono_layout_fill(&r->mono, &r->font, r->mono.x_bearing, pad);
+}
+
+void render_destroy(render_t *r) {
+  cachefile_unmap(&r->cache.map);
+  if (r->atlas.image) cairo_surface_destroy(r->atlas.image);
+  r->atlas.image = NULL;
+  if (r->atlas.surface) cairo_surface_destroy(r->atlas.surface);
+  r->atlas.surface = NULL;
+  if (r->font.scaled) cairo_scaled_font_destroy(r->font.scaled);
+  r->font.scaled = NULL;
+}
+
+void render_layout(render_t *r, const char *s, const frame_t *prev, frame_t *f) {
+  const font_cache_t *font = &r->font;
+  const glyph_atlas_t *atlas = &r->atlas;
+
+  if (f->str != s) {
+    strncpy(f->str, s, sizeof(f->str) - 1);
+    f->str[sizeof(f->str) - 1] = '\0';
+  }
+  s = f->str;
+
+  // Monospace fast path: the size is a function of the length alone.
+  if ((f->use_atlas = atlas_covers(atlas, s)) && r->mono.enabled) {
+    size_t n = strlen(s);
+    f->x_advance = (double)r->mono.pen[n];
+    f->x_bearing = r->mono.x_bearing;
+    f->w = r->mono.w[n];
+    f->h = r->mono.h;
+    f->text_x = r->pad - f->x_bearing;
+    f->text_y = r->pad + font->fe.ascent;
+    return;
+  }
+
+  // Measure text: reuse the last metrics when the string is unchanged
+  // (event-driven redraws), else from the atlas metrics when it covers
+  // the string, otherwise through cairo's text API.
+  if (prev && prev->use_atlas == f->use_atlas && strcmp(s, prev->str) == 0) {
+    f->x_advance = prev->x_advance;
+    f->x_bearing = prev->x_bearing;
+  } else if (f->use_atlas) {
+    f->x_advance = atlas_text_advance(atlas, s);
+    f->x_bearing = atlas->glyphs[(unsigned char)s[0]].x_bearing;
+  } else if (font->scaled || font_cache_init(&r->font, r->family, r->size_px, r->alphabet)) {
+    cairo_text_extents_t te;
+    cairo_scaled_font_text_extents(font->scaled, s, &te);
+    f->x_advance = te.x_advance;
+    f->x_bearing = te.x_bearing;
+  } else {
+    f->x_advance = 0.0;  // no font to draw with; paints the background only
+    f->x_bearing = 0.0;
+  }
+
+  int text_w = (int)(f->x_advance + 0.5);
+  int text_h = (int)(font->fe.ascent + font->fe.descent + 0.5);
+  f->w = (uint16_t)(text_w + r->pad * 2);
+  f->h = (uint16_t)(text_h + r->pad * 2);
+  f->text_x = r->pad - f->x_bearing;      // account for left bearing
+  f->text_y = r->pad + font->fe.ascent;   // baseline
+}
+
+bool render_damage(const render_t *r, const frame_t *prev, const frame_t *f, bool force_full, damage_t *d) {
+  d->full = force_full || !f->use_atlas || !prev->use_atlas ||
+            f->w != prev->w || f->h != prev->h || f->text_x != prev->text_x ||
+            strlen(f->str) != strlen(prev->str) ||
+            memcmp(&f->colors, &prev->colors, sizeof(f->colors)) != 0;
+  d->x0 = 0;
+  d->x1 = f->w;
+  if (d->full) return true;
+
+  size_t first, last;
+  if (!diff_cells(prev->str, f->str, &first, &last)) return false;
+  atlas_cell_span(r, f->text_x, f->str, first, last, &d->x0, &d->x1);
+  if (d->x0 < 0) d->x0 = 0;
+  if (d->x1 > f->w) d->x1 = f->w;
+  return d->x1 > d->x0;
+}
+
+void render_paint(const render_t *r, cairo_t *cr, const frame_t *f, const damage_t *d) {
+  const colors_t *c = &f->colors;
+  cairo_save(cr);
+  if (!d->full) {
+    cairo_rectangle(cr, d->x0, 0, d->x1 - d->x0, f->h);
+    cairo_clip(cr);
+  }
+
+  // Background
+  cairo_set_source_rgb(cr, c->bg_r, c->bg_g, c->bg_b);
+  cairo_paint(cr);
+
+  // Text
+  cairo_set_source_rgb(cr, c->fg_r, c->fg_g, c->fg_b);
+  if (f->use_atlas) {
+    atlas_show_text(r, cr, f->text_x, f->text_y, f->str, d->x0, d->x1);
+  } else if (r->font.scaled) {
+    cairo_set_scaled_font(cr, r->font.scaled);
+    cairo_move_to(cr, f->text_x, f->text_y);
+    cairo_show_text(cr, f->str);
+  }
+  cairo_restore(cr);
+}
+
+void render_paint_mask(const render_t *r, cairo_t *cr, const frame_t *f, const damage_t *d) {
+  cairo_save(cr);
+  if (!d->full) {
+    cairo_rectangle(cr, d->x0, 0, d->x1 - d->x0, f->h);
+    cairo_clip(cr);
+  }
+  cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint(cr);
+  cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+  cairo_set_source_rgba(cr, 0, 0, 0, 1);
+  if (f->use_atlas) {
+    atlas_show_text(r, cr, f->text_x, f->text_y, f->str, d->x0, d->x1);
+  } else if (r->font.scaled) {
+    cairo_set_scaled_font(cr, r->font.scaled);
+    cairo_move_to(cr, f->text_x, f->text_y);
+    cairo_show_text(cr, f->str);
+  }
+  cairo_restore(cr);
+}
@@ -0,0 +1,129 @@
+// render: font cache, glyph atlas and damage-tracked painting of one line
+// of text. Independent of X: it draws with cairo into whatever surface the
+// caller provides (a back-buffer pixmap, or an image surface in --bench).
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cairo/cairo.h>
+
+#include "cachefile.h"
+#include "frame.h"
+#include "overlay.h"
+
+// Characters always rasterized into the atlas (digits and the "(N)" flash
+// suffix); the characters of the --format template are added at startup
+// and whenever it changes.
+#define ATLAS_ALPHABET "0123456789-: ()"
+#define ATLAS_CHARS_MAX 96
+#define RENDER_FAMILY_MAX 256
+
+// The configured font, resolved once into a scaled font. Measurement and
+// drawing both reuse it instead of going through the toy font API per tick.
+typedef struct {
+  cairo_scaled_font_t *scaled;
+  cairo_font_extents_t fe;
+  bool monospace;       // all alphabet glyphs share one advance
+  double mono_advance;
+} font_cache_t;
+
+typedef struct {
+  bool present;
+  int cell_x;        // left edge of this glyph's cell in the atlas
+  double x_advance;
+  double x_bearing;
+} atlas_glyph_t;
+
+// Glyph atlas: one row of fixed-size A8 cells, one per alphabet character.
+// Created similar to the target surface, so with the xcb backend it lives in
+// a server-side pixmap and drawing a glyph is a single masked composite.
+typedef struct {
+  cairo_surface_t *surface;
+  cairo_surface_t *image;  // client-side rasterization until it is uploaded
+  int cell_w, cell_h;
+  int pad_x, pad_y;  // slack around the pen position for ink overhang
+  double ascent, descent;
+  atlas_glyph_t glyphs[128];
+} glyph_atlas_t;
+
+// Layout table for monospace fonts, built once at startup. Every string
+// drawn from the alphabet (the clock plus any "(N)" suffix) has a size
+// that depends only on its length, so layout is a lookup instead of a
+// measurement and the window width never jitters between ticks.
+typedef struct {
+  bool enabled;
+  double x_bearing;             // shared by every string; keeps text_x fixed
+  int pen[FRAME_TEXT_MAX + 1];  // rounded pen offset of cell i from text_x
+  uint16_t w[FRAME_TEXT_MAX];   // window width for a string of length n
+  uint16_t h;
+} mono_layout_t;
+
+// Atlas cache (--no-atlas-cache disables it): the rasterized atlas with the
+// metrics above, stored under $XDG_CACHE_HOME and keyed by font family,
+// size, alphabet, cairo version and the fontconfig caches' mtimes. On a hit
+// the file stays mapped from render_init to render_atlas_init, and the
+// font itself is only loaded if a string ever falls outside the atlas.
+typedef struct {
+  char path[512];       // empty when caching is off
+  char key[512];
+  cachefile_map_t map;
+  const uint8_t *pixels;
+  int stride;
+  bool hit;
+} atlas_cache_t;
+
+typedef struct {
+  char family[RENDER_FAMILY_MAX];  // the font as requested, for lazy loading and the cache key
+  double size_px;
+  char alphabet[ATLAS_CHARS_MAX];  // every character the atlas holds
+  font_cache_t font;               // font.scaled is NULL until needed on a cache hit
+  glyph_atlas_t atlas;
+  mono_layout_t mono;
+  atlas_cache_t cache;
+  uint32_t pad;      // margin around the text inside the window
+} render_t;
+
+// Loads the font, or the metrics from the atlas cache. charset (printable
+// ASCII, may be NULL) lists characters to rasterize in addition to
+// ATLAS_ALPHABET, typically timefmt_charset(). Nothing of opt is kept.
+bool render_init(render_t *r, const options_t *opt, const char *charset);
+// Rasterizes the atlas client side and stores it in the cache; nothing to
+// do after a cache hit. Makes no X requests, so it may run on another
+// thread together with render_init.
+bool render_atlas_prepare(render_t *r);
+// Uploads the prepared (or cached) atlas into a surface similar to `like`,
+// preparing it first if needed. On failure rendering falls back to
+// cairo_show_text and false is returned.
+bool render_atlas_init(render_t *r, cairo_surface_t *like);
+// Makes dst a renderer for another X connection: font, metrics and layout
+// table are shared with src (which must have been prepared and keeps its
+// atlas source), and src's atlas is uploaded into a surface similar to
+// `like`. dst is destroyed on its own. Returns false (dst then draws with
+// cairo_show_text) if the upload fails.
+bool render_share(render_t *dst, const render_t *src, cairo_surface_t *like);
+// Changes the margin around the text; the layout table follows, and the
+// next frame must be laid out without reusing the previous one.
+void render_set_pad(render_t *r, uint32_t pad);
+void render_destroy(render_t *r);
+
+// Lays out s into f (size, origin, metrics). Reuses prev's metrics when the
+// string is unchanged, and uses the monospace table when the atlas covers s;
+// only proportional fonts measure per string (loading the font first after
+// a cache hit). Colors are left to the caller.
+void render_layout(render_t *r, const char *s, const frame_t *prev, frame_t *f);
+
+// Damage between prev and f. Anything that moves or recolors the whole line
+// (or force_full) makes a full repaint; otherwise only the span of the
+// changed cells. Returns false if nothing needs repainting.
+bool render_damage(const render_t *r, const frame_t *prev, const frame_t *f, bool force_full, damage_t *d);
+
+// Paints the damaged part of f with cr (state is saved and restored).
+void render_paint(const render_t *r, cairo_t *cr, const frame_t *f, const damage_t *d);
+
+// Like render_paint, but draws only the coverage of the damaged text into
+// an alpha-only surface (colors are ignored), for the XRender line mask.
+void render_paint_mask(const render_t *r, cairo_t *cr, const frame_t *f, const damage_t *d);
+
+#endif
@@ -0,0 +1,184 @@
+// settings: runtime-changeable options. See settings.h.
+#define _POSIX_C_SOURCE 200809L
+#include "settings.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timefmt.h"
+
+// Options that only take effect at startup: they decide which X resources
+// and extensions exist at all.
+static const char *const startup_only[] = {
+  "backend", "flash-mode", "outputs", "precision", "render-ahead", "no-atlas-cache",
+  "displays", "display-dir", "zone", "status", "stats", "stats-file", "debug", "control", "config",
+};
+
+static int parse_hex2(const char *p) {
+  int v = 0;
+  for (int i = 0; i < 2; ++i) {
+    char c = p[i];
+    if (!isxdigit((unsigned char)c)) return -1;
+    v <<= 4;
+    if (c >= '0' && c <= '9') v |= (c - '0');
+    else if (c >= 'a' && c <= 'f') v |= (c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F') v |= (c - 'A' + 10);
+  }
+  return v;
+}
+
+static bool parse_rgb_hex(const char *hex, double *r, double *g, double *b) {
+  // Accept "#RRGGBB" or "RRGGBB"
+  const char *p = hex;
+  if (hex[0] == '#') p++;
+  if (strlen(p) != 6) return false;
+  int rr = parse_hex2(p);
+  int gg = parse_hex2(p+2);
+  int bb = parse_hex2(p+4);
+  if (rr < 0 || gg < 0 || bb < 0) return false;
+  *r = rr / 255.0;
+  *g = gg / 255.0;
+  *b = bb / 255.0;
+  return true;
+}
+
+// Flags take an optional value: empty (as on the command line) means on.
+static bool parse_flag(const char *v, bool *out) {
+  if (!v[0] || strcmp(v, "on") == 0 || strcmp(v, "true") == 0 || strcmp(v, "yes") == 0 || strcmp(v, "1") == 0) {
+    *out = true;
+  } else if (strcmp(v, "off") == 0 || strcmp(v, "false") == 0 || strcmp(v, "no") == 0 || strcmp(v, "0") == 0) {
+    *out = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool copy_str(char *dst, size_t size, const char *v) {
+  if (strlen(v) >= size) return false;
+  memcpy(dst, v, strlen(v) + 1);
+  return true;
+}
+
+bool settings_set(settings_t *s, options_t *o, const char *key, const char *value, char *err, size_t err_size) {
+  const char *why = NULL;
+  if (strcmp(key, "font") == 0) {
+    if (!value[0] || !copy_str(s->font_family, sizeof(s->font_family), value)) why = "use a font family name";
+    else o->font_family = s->font_family;
+  } else if (strcmp(key, "size") == 0) {
+    o->font_size_px = strtod(value, NULL);
+    if (o->font_size_px <= 0) o->font_size_px = 16.0;
+  } else if (strcmp(key, "fg") == 0) {
+    if (!parse_rgb_hex(value, &o->fg_r, &o->fg_g, &o->fg_b)) why = "use #RRGGBB";
+  } else if (strcmp(key, "bg") == 0) {
+    if (!parse_rgb_hex(value, &o->bg_r, &o->bg_g, &o->bg_b)) why = "use #RRGGBB";
+  } else if (strcmp(key, "margin") == 0) {
+    o->margin_px = (uint32_t)strtoul(value, NULL, 10);
+  } else if (strcmp(key, "time-only") == 0) {
+    if (!parse_flag(value, &o->time_only)) why = "use on or off";
+  } else if (strcmp(key, "format") == 0) {
+    if (!copy_str(s->format, sizeof(s->format), value)) why = "template too long";
+  } else if (strcmp(key, "flash") == 0) {
+    long v = strtol(value, NULL, 10);
+    o->flash_minutes = v < 0 ? 0 : (int)v;
+  } else if (strcmp(key, "show-flash-count") == 0) {
+    if (!parse_flag(value, &o->show_flash_count)) why = "use on or off";
+  } else {
+    why = "unknown setting";
+    for (size_t i = 0; i < sizeof(startup_only) / sizeof(startup_only[0]); ++i) {
+      if (strcmp(key, startup_only[i]) == 0) why = "only settable at startup";
+    }
+  }
+  if (why) snprintf(err, err_size, "%s", why);
+  return why == NULL;
+}
+
+static char *trim(char *p) {
+  while (isspace((unsigned char)*p)) ++p;
+  size_t n = strlen(p);
+  while (n && isspace((unsigned char)p[n - 1])) p[--n] = '\0';
+  return p;
+}
+
+bool settings_load(settings_t *s, options_t *o, const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  char line[SETTINGS_STR_MAX * 2];
+  bool ok = true;
+  for (int n = 1; ok && fgets(line, sizeof(line), f); ++n) {
+    char *p = trim(line);
+    if (!*p || *p == '#') continue;
+    char *eq = strchr(p, '=');
+    char err[64];
+    if (!eq) {
+      fprintf(stderr, "%s:%d: expected key = value\n", path, n);
+      ok = false;
+    } else {
+      *eq = '\0';
+      const char *key = trim(p), *value = trim(eq + 1);
+      ok = settings_set(s, o, key, value, err, sizeof(err));
+      if (!ok) fprintf(stderr, "%s:%d: %s: %s\n", path, n, key, err);
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+void settings_reset(options_t *o, const options_t *defaults) {
+  o->font_family = defaults->font_family;
+  o->font_size_px = defaults->font_size_px;
+  o->margin_px = defaults->margin_px;
+  o->fg_r = defaults->fg_r; o->fg_g = defaults->fg_g; o->fg_b = defaults->fg_b;
+  o->bg_r = defaults->bg_r; o->bg_g = defaults->bg_g; o->bg_b = defaults->bg_b;
+  o->time_only = defaults->time_only;
+  o->format = defaults->format;
+  o->flash_minutes = defaults->flash_minutes;
+  o->show_flash_count = defaults->show_flash_count;
+}
+
+void settings_copy(settings_t *dst, const settings_t *src, options_t *o) {
+  *dst = *src;
+  if (o->font_family == src->font_family) o->font_family = dst->font_family;
+  if (o->format == src->effective) o->format = dst->effective;
+}
+
+void settings_finish(settings_t *s, options_t *o) {
+  const char *format = s->format[0] ? s->format : o->time_only ? TIMEFMT_TIME_ONLY : TIMEFMT_DEFAULT;
+  // --precision appends the sub-second digits unless the template has them.
+  if (o->precision != PRECISION_NONE && !strstr(format, "%{ms}") && !strstr(format, "%{cs}")) {
+    snprintf(s->effective, sizeof(s->effective), "%s.%s", format,
+             o->precision == PRECISION_MS ? "%{ms}" : "%{cs}");
+  } else {
+    snprintf(s->effective, sizeof(s->effective), "%s", format);
+  }
+  o->format = s->effective;
+}
+
+unsigned settings_changes(const options_t *a, const options_t *b) {
+  unsigned c = 0;
+  if (a->fg_r != b->fg_r || a->fg_g != b->fg_g || a->fg_b != b->fg_b ||
+      a->bg_r != b->bg_r || a->bg_g != b->bg_g || a->bg_b != b->bg_b) c |= SETTINGS_COLORS;
+  if (strcmp(a->font_family, b->font_family) != 0 || a->font_size_px != b->font_size_px) c |= SETTINGS_FONT;
+  if (a->margin_px != b->margin_px) c |= SETTINGS_MARGIN;
+  if (strcmp(a->format, b->format) != 0) c |= SETTINGS_FORMAT;
+  if (a->flash_minutes != b->flash_minutes || a->show_flash_count != b->show_flash_count) c |= SETTINGS_FLASH;
+  return c;
+}
+
+static int hex8(double v) {
+  return (int)(v * 255.0 + 0.5);
+}
+
+void settings_format(const settings_t *s, const options_t *o, char *out, size_t size) {
+  snprintf(out, size,
+           "font = %s\nsize = %g\nfg = #%02X%02X%02X\nbg = #%02X%02X%02X\nmargin = %u\n"
+           "time-only = %s\nformat = %s\nflash = %d\nshow-flash-count = %s\n",
+           o->font_family, o->font_size_px, hex8(o->fg_r), hex8(o->fg_g), hex8(o->fg_b),
+           hex8(o->bg_r), hex8(o->bg_g), hex8(o->bg_b), o->margin_px, o->time_only ? "on" : "off",
+           s->format, o->flash_minutes, o->show_flash_count ? "on" : "off");
+}
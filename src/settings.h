@@ -0,0 +1,60 @@
+// settings: the options that can change while running, set from the command
+// line, a --config file (re-read on SIGHUP) or the control socket. Values
+// are parsed from "key value" pairs named like the long options, and a
+// change is classified by what it invalidates, so colors never redo font
+// work and a new format never touches the X connections.
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "overlay.h"
+
+#define SETTINGS_STR_MAX 256
+
+// What a change of settings invalidates.
+enum {
+  SETTINGS_COLORS = 1u << 0,  // fade table; frames recolor on their own
+  SETTINGS_FONT   = 1u << 1,  // font, atlas and layout tables
+  SETTINGS_MARGIN = 1u << 2,  // layout tables and the anchored position
+  SETTINGS_FORMAT = 1u << 3,  // the compiled clock template (and maybe the atlas alphabet)
+  SETTINGS_FLASH  = 1u << 4,  // flash interval and the count suffix
+};
+
+// Storage for the strings of an options_t built from settings. An
+// options_t points into one of these; a change is built in a second one,
+// so the old and new values can be compared before switching.
+typedef struct {
+  char font_family[SETTINGS_STR_MAX];
+  char format[SETTINGS_STR_MAX];          // --format as given; empty: the default
+  char effective[SETTINGS_STR_MAX + 16];  // the template compiled by timefmt
+} settings_t;
+
+// Sets key (a long option name, e.g. "fg") to value in o, copying strings
+// into s. Returns false with a reason in err if the key cannot be changed
+// or the value is invalid.
+bool settings_set(settings_t *s, options_t *o, const char *key, const char *value, char *err, size_t err_size);
+
+// Applies the "key = value" lines of the file at path ('#' starts a
+// comment). Prints the problem (with its line) and returns false if the
+// file cannot be read or a line is invalid.
+bool settings_load(settings_t *s, options_t *o, const char *path);
+
+// Resets every setting of o to its value in defaults.
+void settings_reset(options_t *o, const options_t *defaults);
+
+// Makes dst a copy of src and repoints o's strings from src into dst.
+void settings_copy(settings_t *dst, const settings_t *src, options_t *o);
+
+// Derives the template to compile (--format, --time-only, --precision)
+// into o->format.
+void settings_finish(settings_t *s, options_t *o);
+
+// SETTINGS_* bits for what differs between a and b.
+unsigned settings_changes(const options_t *a, const options_t *b);
+
+// Writes o's settings, in config file syntax, to out.
+void settings_format(const settings_t *s, const options_t *o, char *out, size_t size);
+
+#endif
@@ -0,0 +1,106 @@
+// shmbuf: MIT-SHM segment backing a client-side back buffer. See shmbuf.h.
+#define _XOPEN_SOURCE 700  // SysV shared memory
+#include "shmbuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+bool shmbuf_probe(shmbuf_t *sb, xcb_connection_t *c, xcb_screen_t *screen,
+                  const xcb_visualtype_t *visual, cairo_format_t *format) {
+  memset(sb, 0, sizeof(*sb));
+  const xcb_query_extension_reply_t *ext = xcb_get_extension_data(c, &xcb_shm_id);
+  if (!ext || !ext->present) return false;
+  sb->completion_event = ext->first_event + XCB_SHM_COMPLETION;
+
+  // The segment is written with host byte order 32bpp pixels.
+  const xcb_setup_t *setup = xcb_get_setup(c);
+  const uint16_t one = 1;
+  uint8_t host_order = *(const uint8_t *)&one ? XCB_IMAGE_ORDER_LSB_FIRST : XCB_IMAGE_ORDER_MSB_FIRST;
+  if (setup->image_byte_order != host_order) return false;
+  bool bpp32 = false;
+  xcb_format_iterator_t fi = xcb_setup_pixmap_formats_iterator(setup);
+  for (; fi.rem; xcb_format_next(&fi)) {
+    if (fi.data->depth == screen->root_depth) bpp32 = fi.data->bits_per_pixel == 32;
+  }
+  if (!bpp32 || visual->red_mask != 0xff0000 || visual->green_mask != 0x00ff00 ||
+      visual->blue_mask != 0x0000ff) {
+    return false;
+  }
+  if (screen->root_depth == 24) *format = CAIRO_FORMAT_RGB24;
+  else if (screen->root_depth == 32) *format = CAIRO_FORMAT_ARGB32;
+  else return false;
+  return true;
+}
+
+static void shmbuf_release(shmbuf_t *sb, xcb_connection_t *c) {
+  if (!sb->addr) return;
+  shmbuf_wait(sb, c);
+  xcb_shm_detach(c, sb->seg);
+  shmdt(sb->addr);
+  sb->addr = NULL;
+  sb->size = 0;
+}
+
+bool shmbuf_reserve(shmbuf_t *sb, xcb_connection_t *c, size_t size) {
+  if (sb->addr && sb->size >= size) return true;
+  shmbuf_release(sb, c);
+
+  // Round up so a growing flash counter does not reallocate every digit.
+  size = (size + 65535) & ~(size_t)65535;
+  int id = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+  if (id < 0) return false;
+  void *addr = shmat(id, NULL, 0);
+  if (addr == (void *)-1) {
+    shmctl(id, IPC_RMID, NULL);
+    return false;
+  }
+  if (!sb->seg) sb->seg = xcb_generate_id(c);
+  xcb_generic_error_t *err = xcb_request_check(c, xcb_shm_attach_checked(c, sb->seg, (uint32_t)id, 1));
+  sb->round_trips++;
+  // Marked for removal now; it lives until both sides detach.
+  shmctl(id, IPC_RMID, NULL);
+  if (err) {
+    // A server on another host cannot see our segment.
+    free(err);
+    shmdt(addr);
+    return false;
+  }
+  sb->addr = addr;
+  sb->size = size;
+  return true;
+}
+
+void shmbuf_wait(shmbuf_t *sb, xcb_connection_t *c) {
+  if (!sb->put_pending) return;
+  // Replies are ordered after the put, so one round trip is enough. The
+  // completions it overtook stay queued; their sequence marks them stale.
+  free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+  sb->round_trips++;
+  sb->put_pending = false;
+}
+
+void shmbuf_put(shmbuf_t *sb, xcb_connection_t *c, xcb_drawable_t dst, xcb_gcontext_t gc,
+                uint8_t depth, uint16_t total_w, uint16_t total_h,
+                int16_t x, int16_t y, uint16_t w, uint16_t h) {
+  xcb_void_cookie_t ck = xcb_shm_put_image(c, dst, gc, total_w, total_h, (uint16_t)x, (uint16_t)y,
+                                           w, h, x, y, depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 1, sb->seg, 0);
+  sb->last_put_seq = ck.sequence;
+  sb->put_pending = true;
+}
+
+bool shmbuf_handle_event(shmbuf_t *sb, const xcb_generic_event_t *ev) {
+  if (!sb->addr || (ev->response_type & ~0x80) != sb->completion_event) return false;
+  const xcb_shm_completion_event_t *ce = (const xcb_shm_completion_event_t *)ev;
+  // A completion carries the sequence of its put; anything earlier than the
+  // latest put says nothing about whether the server is done reading.
+  if (ce->shmseg == sb->seg && (int32_t)(ev->full_sequence - sb->last_put_seq) >= 0) {
+    sb->put_pending = false;
+  }
+  return true;
+}
+
+void shmbuf_destroy(shmbuf_t *sb, xcb_connection_t *c) {
+  shmbuf_release(sb, c);
+}
@@ -0,0 +1,49 @@
+// shmbuf: MIT-SHM segment backing a client-side back buffer. Frames are
+// rasterized into a Cairo image surface over the segment and presented with
+// ShmPutImage, so large frames never travel through the X socket.
+#ifndef SHMBUF_H
+#define SHMBUF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <xcb/xcb.h>
+#include <xcb/shm.h>
+#include <cairo/cairo.h>
+
+typedef struct {
+  xcb_shm_seg_t seg;
+  uint8_t *addr;
+  size_t size;
+  uint8_t completion_event;  // ShmCompletion response type
+  bool put_pending;          // the server may still be reading the segment
+  uint32_t last_put_seq;     // request sequence of the latest put
+  unsigned round_trips;      // replies waited for (attach, wait), for --stats
+} shmbuf_t;
+
+// Checks that MIT-SHM is present and that the screen's visual has a pixel
+// layout Cairo can draw into directly. On success fills *format and the
+// completion event code in *sb.
+bool shmbuf_probe(shmbuf_t *sb, xcb_connection_t *c, xcb_screen_t *screen,
+                  const xcb_visualtype_t *visual, cairo_format_t *format);
+
+// Makes the segment at least size bytes, attaching it to the server. Fails
+// when the server cannot attach it (e.g. a remote connection).
+bool shmbuf_reserve(shmbuf_t *sb, xcb_connection_t *c, size_t size);
+
+// Blocks until the server is done with the last put.
+void shmbuf_wait(shmbuf_t *sb, xcb_connection_t *c);
+
+void shmbuf_put(shmbuf_t *sb, xcb_connection_t *c, xcb_drawable_t dst, xcb_gcontext_t gc,
+                uint8_t depth, uint16_t total_w, uint16_t total_h,
+                int16_t x, int16_t y, uint16_t w, uint16_t h);
+
+// Returns true if ev was our ShmCompletion. Only the completion of the
+// latest put clears the pending state; completions still queued for earlier
+// puts (e.g. behind a shmbuf_wait round trip) are consumed and ignored.
+bool shmbuf_handle_event(shmbuf_t *sb, const xcb_generic_event_t *ev);
+
+void shmbuf_destroy(shmbuf_t *sb, xcb_connection_t *c);
+
+#endif
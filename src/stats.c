@@ -0,0 +1,186 @@
+// stats: low-overhead runtime instrumentation. See stats.h.
+#define _POSIX_C_SOURCE 200809L
+#include "stats.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *const stat_names[STAT_COUNT] = {
+  [STAT_EVENTS]    = "events",
+  [STAT_FLASH]     = "flash",
+  [STAT_FORMAT]    = "format",
+  [STAT_MEASURE]   = "measure",
+  [STAT_CONFIGURE] = "configure",
+  [STAT_PAINT]     = "paint",
+  [STAT_FLUSH]     = "flush",
+  [STAT_LATENCY]   = "latency",
+  [STAT_REQUESTS]  = "requests",
+  [STAT_BYTES]     = "bytes",
+  [STAT_ROUND_TRIPS] = "roundtrips",
+  [STAT_XEVENTS]   = "xevents",
+};
+
+// Unit of each histogram; nanoseconds unless listed.
+static const char *const stat_units[STAT_COUNT] = {
+  [STAT_REQUESTS]  = "requests",
+  [STAT_BYTES]     = "bytes",
+  [STAT_ROUND_TRIPS] = "round trips",
+  [STAT_XEVENTS]   = "events",
+};
+
+void stats_init(stats_t *s, bool enabled, const char *path) {
+  memset(s, 0, sizeof(*s));
+  s->enabled = enabled;
+  s->path = path;
+  s->start_ns = mono_now_ns();
+  s->minute_epoch = s->start_ns / (60 * NS_PER_SEC);
+  // Kept open for the process lifetime and re-read with pread.
+  s->io_fd = enabled ? open("/proc/self/io", O_RDONLY | O_CLOEXEC) : -1;
+}
+
+void stats_reset(stats_t *s) {
+  s->start_ns = mono_now_ns();
+  s->minute_epoch = s->start_ns / (60 * NS_PER_SEC);
+  s->wakeups = s->ticks = s->vsync_frames = s->vsync_missed = s->x_events = 0;
+  memset(s->minute_wakeups, 0, sizeof(s->minute_wakeups));
+  memset(s->hist, 0, sizeof(s->hist));
+}
+
+static bool read_wchar(const stats_t *s, uint64_t *out) {
+  if (s->io_fd < 0) return false;
+  char buf[512];
+  ssize_t n = pread(s->io_fd, buf, sizeof(buf) - 1, 0);
+  if (n <= 0) return false;
+  buf[n] = '\0';
+  const char *p = strstr(buf, "wchar:");
+  if (!p) return false;
+  *out = strtoull(p + 6, NULL, 10);
+  return true;
+}
+
+int64_t stats_bytes_written(stats_t *s) {
+  uint64_t written;
+  if (!read_wchar(s, &written)) return -1;
+  int64_t delta = s->io_written ? (int64_t)(written - s->io_written + s->io_pending) : -1;
+  s->io_written = written;
+  s->io_pending = 0;
+  return delta;
+}
+
+void stats_bytes_exclude_begin(stats_t *s) {
+  uint64_t written;
+  if (!s->io_written || !read_wchar(s, &written)) return;
+  s->io_pending += written - s->io_written;
+  s->io_written = written;
+}
+
+void stats_bytes_exclude_end(stats_t *s) {
+  uint64_t written;
+  if (s->io_written && read_wchar(s, &written)) s->io_written = written;
+}
+
+bool stats_check_budget(const stats_t *s, double max_requests, double max_bytes) {
+  const stats_hist_t *rq = &s->hist[STAT_REQUESTS], *by = &s->hist[STAT_BYTES];
+  double requests = rq->n ? (double)rq->sum / (double)rq->n : 0.0;
+  double bytes = by->n ? (double)by->sum / (double)by->n : 0.0;
+  bool ok = rq->n > 0 && (!max_requests || requests <= max_requests) && (!max_bytes || bytes <= max_bytes);
+  fprintf(stderr, "[stats] budget %s: %.2f requests/tick (max %g), %.0f bytes/tick (max %g) over %llu ticks\n",
+          ok ? "met" : "exceeded", requests, max_requests, bytes, max_bytes, (unsigned long long)rq->n);
+  return ok;
+}
+
+static int bucket_of(uint64_t v) {
+  int b = 0;
+  while (v && b < STATS_BUCKETS - 1) {
+    v >>= 1;
+    ++b;
+  }
+  return b;
+}
+
+void stats_add(stats_t *s, int stat, uint64_t value) {
+  if (!s->enabled) return;
+  stats_hist_t *h = &s->hist[stat];
+  h->buckets[bucket_of(value)]++;
+  h->n++;
+  h->sum += value;
+  if (value > h->max) h->max = value;
+}
+
+void stats_wakeup(stats_t *s) {
+  if (!s->enabled) return;
+  s->wakeups++;
+  int64_t minute = mono_now_ns() / (60 * NS_PER_SEC);
+  int64_t shift = minute - s->minute_epoch;
+  if (shift > 0) {
+    // Slide the per-minute window so slot 0 is the current minute.
+    if (shift >= STATS_MINUTES) {
+      memset(s->minute_wakeups, 0, sizeof(s->minute_wakeups));
+    } else {
+      memmove(s->minute_wakeups + shift, s->minute_wakeups,
+              (size_t)(STATS_MINUTES - shift) * sizeof(s->minute_wakeups[0]));
+      memset(s->minute_wakeups, 0, (size_t)shift * sizeof(s->minute_wakeups[0]));
+    }
+    s->minute_epoch = minute;
+  }
+  s->minute_wakeups[0]++;
+}
+
+// Upper bound of the bucket holding the p-th quantile.
+static uint64_t hist_quantile(const stats_hist_t *h, double p) {
+  if (!h->n) return 0;
+  uint64_t want = (uint64_t)(p * (double)h->n + 0.5);
+  if (want < 1) want = 1;
+  uint64_t seen = 0;
+  for (int b = 0; b < STATS_BUCKETS; ++b) {
+    seen += h->buckets[b];
+    if (seen >= want) {
+      uint64_t hi = b ? (1ULL << b) - 1 : 0;
+      return hi < h->max ? hi : h->max;
+    }
+  }
+  return h->max;
+}
+
+void stats_dump(const stats_t *s) {
+  FILE *out = stderr;
+  if (s->path) {
+    out = fopen(s->path, "a");
+    if (!out) {
+      perror(s->path);
+      return;
+    }
+  }
+
+  double up_min = (double)(mono_now_ns() - s->start_ns) / (60.0 * NS_PER_SEC);
+  fprintf(out, "[stats] uptime %.1f min, %llu wakeups (%.1f/min), %llu ticks, last minute %u wakeups\n",
+          up_min, (unsigned long long)s->wakeups,
+          up_min > 0 ? (double)s->wakeups / up_min : 0.0,
+          (unsigned long long)s->ticks, s->minute_wakeups[1]);
+  fprintf(out, "[stats] X: %llu requests, %llu bytes, %llu round trips, %llu events\n",
+          (unsigned long long)s->hist[STAT_REQUESTS].sum, (unsigned long long)s->hist[STAT_BYTES].sum,
+          (unsigned long long)s->hist[STAT_ROUND_TRIPS].sum, (unsigned long long)s->x_events);
+  if (s->vsync_frames) {
+    fprintf(out, "[stats] vsync: %llu frames, %llu missed vblanks (%.2f%%)\n",
+            (unsigned long long)s->vsync_frames, (unsigned long long)s->vsync_missed,
+            100.0 * (double)s->vsync_missed / (double)(s->vsync_frames + s->vsync_missed));
+  }
+  fprintf(out, "[stats] %-10s %10s %12s %12s %12s %12s %12s\n",
+          "stage", "count", "mean", "p50<=", "p90<=", "p99<=", "max");
+  for (int i = 0; i < STAT_COUNT; ++i) {
+    const stats_hist_t *h = &s->hist[i];
+    fprintf(out, "[stats] %-10s %10llu %12.0f %12llu %12llu %12llu %12llu (%s)\n",
+            stat_names[i], (unsigned long long)h->n,
+            h->n ? (double)h->sum / (double)h->n : 0.0,
+            (unsigned long long)hist_quantile(h, 0.50),
+            (unsigned long long)hist_quantile(h, 0.90),
+            (unsigned long long)hist_quantile(h, 0.99),
+            (unsigned long long)h->max,
+            stat_units[i] ? stat_units[i] : "ns");
+  }
+  fflush(out);
+  if (out != stderr) fclose(out);
+}
@@ -0,0 +1,100 @@
+// stats: low-overhead runtime instrumentation for --stats.
+// Fixed-size log2 histograms per tick stage, boundary-to-present latency,
+// wakeups per minute and the X traffic of each tick (requests, bytes, round
+// trips, events). Nothing is printed until a dump is requested (SIGUSR1), so
+// collecting does not perturb the timing.
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "overlay.h"
+
+#define STATS_BUCKETS 40        // bucket i holds values in [2^(i-1), 2^i)
+#define STATS_MINUTES 60        // wakeup counts kept for the last hour
+
+enum {
+  STAT_EVENTS,     // event drain
+  STAT_FLASH,      // flash update + color computation
+  STAT_FORMAT,     // clock string
+  STAT_MEASURE,    // layout
+  STAT_CONFIGURE,  // ConfigureWindow decision
+  STAT_PAINT,      // damage, paint and present copy
+  STAT_FLUSH,      // xcb_flush
+  STAT_LATENCY,    // second boundary -> frame flushed
+  STAT_REQUESTS,   // X requests per tick (count, not ns)
+  STAT_BYTES,      // bytes written per tick (see stats_bytes_written)
+  STAT_ROUND_TRIPS,// replies waited for per tick
+  STAT_XEVENTS,    // X events handled per tick
+  STAT_COUNT
+};
+
+typedef struct {
+  uint64_t buckets[STATS_BUCKETS];
+  uint64_t n, sum, max;
+} stats_hist_t;
+
+typedef struct {
+  bool enabled;
+  const char *path;          // dump destination; NULL means stderr
+  int64_t start_ns;          // monotonic start of collection
+  uint64_t wakeups;
+  uint64_t ticks;
+  uint64_t vsync_frames;     // --precision: vblank wakeups (Present)
+  uint64_t vsync_missed;     // vblanks that went by without a frame
+  uint64_t x_events;         // X events handled
+  int io_fd;                 // /proc/self/io, -1 if unavailable
+  uint64_t io_written;       // its wchar at the last read
+  uint64_t io_pending;       // bytes of the tick read before an excluded write
+  int64_t minute_epoch;      // monotonic minute index of minute_wakeups[0]
+  uint32_t minute_wakeups[STATS_MINUTES];
+  stats_hist_t hist[STAT_COUNT];
+} stats_t;
+
+void stats_init(stats_t *s, bool enabled, const char *path);
+
+// Starts collecting afresh, e.g. at the start of a budget window; the byte
+// counter keeps its baseline.
+void stats_reset(stats_t *s);
+
+// Monotonic timestamp for stage timing; 0 (and no syscall) when disabled.
+static inline int64_t stats_now(const stats_t *s) {
+  return s->enabled ? mono_now_ns() : 0;
+}
+
+void stats_add(stats_t *s, int stat, uint64_t value);
+
+// Adds the time since t0 (from stats_now) to a stage and returns now.
+static inline int64_t stats_stage(stats_t *s, int stat, int64_t t0) {
+  if (!s->enabled) return 0;
+  int64_t t1 = mono_now_ns();
+  stats_add(s, stat, (uint64_t)(t1 - t0));
+  return t1;
+}
+
+void stats_wakeup(stats_t *s);
+
+// Bytes the process wrote (write, writev, sendmsg...) since the last call,
+// from the wchar counter of /proc/self/io, since libxcb exposes no byte
+// counts. Writes of the main thread bracketed by stats_bytes_exclude_* are
+// left out; anything else is counted as X traffic: --debug output, and the
+// font worker's eventfd and atlas cache file, written before the first
+// frame (which budgets skip) and again on a runtime font change. Returns -1
+// on the first call or when unavailable.
+int64_t stats_bytes_written(stats_t *s);
+
+// Bracket a main-thread write that is not X traffic (a control reply, a
+// stats dump), so stats_bytes_written leaves it out.
+void stats_bytes_exclude_begin(stats_t *s);
+void stats_bytes_exclude_end(stats_t *s);
+
+// --stats-budget: compares the mean requests and bytes per tick with the
+// limits (0: unchecked). Prints the verdict and returns false if over.
+bool stats_check_budget(const stats_t *s, double max_requests, double max_bytes);
+
+// Writes all histograms to s->path (appending) or stderr.
+void stats_dump(const stats_t *s);
+
+#endif
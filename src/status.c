@@ -0,0 +1,270 @@
+// status: extra segments after the clock. See status.h.
+#define _POSIX_C_SOURCE 200809L
+#include "status.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "overlay.h"
+
+#define LOADAVG_PATH "/proc/loadavg"
+#define POWER_SUPPLY_DIR "/sys/class/power_supply"
+
+// The kernel recomputes the load average every 5 s; battery readings move
+// slowly. A value may be up to one period late, to share an earlier wakeup.
+#define LOADAVG_PERIOD_NS (5 * NS_PER_SEC)
+#define BATTERY_PERIOD_NS (30 * NS_PER_SEC)
+
+static int64_t deadline(const status_seg_t *g) {
+  return g->due_ns + g->slack_ns;
+}
+
+static void heap_swap(status_t *s, size_t a, size_t b) {
+  uint8_t t = s->heap[a];
+  s->heap[a] = s->heap[b];
+  s->heap[b] = t;
+}
+
+static void heap_down(status_t *s, size_t i) {
+  for (;;) {
+    size_t l = i * 2 + 1, r = l + 1, m = i;
+    if (l < s->n_heap && deadline(&s->segs[s->heap[l]]) < deadline(&s->segs[s->heap[m]])) m = l;
+    if (r < s->n_heap && deadline(&s->segs[s->heap[r]]) < deadline(&s->segs[s->heap[m]])) m = r;
+    if (m == i) return;
+    heap_swap(s, i, m);
+    i = m;
+  }
+}
+
+static void heap_up(status_t *s, size_t i) {
+  while (i > 0 && deadline(&s->segs[s->heap[i]]) < deadline(&s->segs[s->heap[(i - 1) / 2]])) {
+    heap_swap(s, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+void status_init(status_t *s) {
+  memset(s, 0, sizeof(*s));
+  s->segs[0] = (status_seg_t){ .kind = STATUS_FLASH_COUNT, .fd = { -1, -1 } };
+  s->n_segs = 1;
+}
+
+void status_destroy(status_t *s) {
+  for (size_t i = 0; i < s->n_segs; ++i) {
+    for (int k = 0; k < 2; ++k) {
+      if (s->segs[i].fd[k] >= 0) close(s->segs[i].fd[k]);
+      s->segs[i].fd[k] = -1;
+    }
+  }
+  s->n_segs = 0;
+  s->n_heap = 0;
+}
+
+// Reads the whole (small) file behind fd from the start, NUL-terminated
+// and without the trailing newline. Returns false if nothing was read.
+static bool read_source(int fd, char *buf, size_t size) {
+  ssize_t n;
+  do {
+    n = pread(fd, buf, size - 1, 0);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) return false;
+  while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' ')) --n;
+  buf[n] = '\0';
+  return true;
+}
+
+static int open_source(const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) perror(path);
+  return fd;
+}
+
+// Next instant at or after t whose local time is minute m of the day.
+static time_t next_minute_of_day(time_t t, int m) {
+  struct tm tm;
+  localtime_r(&t, &tm);
+  tm.tm_hour = m / 60;
+  tm.tm_min = m % 60;
+  tm.tm_sec = 0;
+  tm.tm_isdst = -1;
+  time_t at = mktime(&tm);
+  if (at <= t) {
+    tm.tm_mday++;
+    tm.tm_hour = m / 60;
+    tm.tm_min = m % 60;
+    tm.tm_isdst = -1;
+    at = mktime(&tm);
+  }
+  return at;
+}
+
+static void refresh(status_seg_t *g, const struct timespec *now) {
+  int64_t now_ns = (int64_t)now->tv_sec * NS_PER_SEC + now->tv_nsec;
+  char buf[64];
+  switch (g->kind) {
+    case STATUS_FLASH_COUNT:
+      return;
+    case STATUS_LOADAVG:
+      // "0.52 0.58 0.59 1/123 4567": the 1-minute figure.
+      if (read_source(g->fd[0], buf, sizeof(buf))) snprintf(g->text, sizeof(g->text), "%.*s", (int)strcspn(buf, " "), buf);
+      else g->text[0] = '\0';
+      g->due_ns = now_ns + g->period_ns;
+      return;
+    case STATUS_BATTERY: {
+      char state[32] = "";
+      if (g->fd[1] >= 0) read_source(g->fd[1], state, sizeof(state));
+      if (read_source(g->fd[0], buf, sizeof(buf))) {
+        snprintf(g->text, sizeof(g->text), "%d%%%s", atoi(buf), strcmp(state, "Charging") == 0 ? "+" : "");
+      } else {
+        g->text[0] = '\0';
+      }
+      g->due_ns = now_ns + g->period_ns;
+      return;
+    }
+    case STATUS_COUNTDOWN: {
+      // Whole minutes left, rounded up, so it steps on the clock's own
+      // minute boundaries and never needs a wakeup of its own.
+      if (!g->target_at || now->tv_sec >= g->target_at) g->target_at = next_minute_of_day(now->tv_sec, g->target_min);
+      long left = (long)((g->target_at - now->tv_sec + 59) / 60);
+      snprintf(g->text, sizeof(g->text), "T-%ld:%02ld", left / 60, left % 60);
+      g->due_ns = ((int64_t)now->tv_sec / 60 + 1) * 60 * NS_PER_SEC;
+      return;
+    }
+  }
+}
+
+static bool add_one(status_t *s, const char *name, const char *arg) {
+  if (s->n_segs == STATUS_SEGS_MAX) {
+    fprintf(stderr, "Too many --status segments (max %d)\n", STATUS_SEGS_MAX - 1);
+    return false;
+  }
+  status_seg_t g = { .fd = { -1, -1 } };
+  char path[256];
+  if (strcmp(name, "loadavg") == 0 && !arg) {
+    g.kind = STATUS_LOADAVG;
+    g.period_ns = g.slack_ns = LOADAVG_PERIOD_NS;
+    if ((g.fd[0] = open_source(LOADAVG_PATH)) < 0) return false;
+  } else if (strcmp(name, "battery") == 0) {
+    const char *dev = arg ? arg : "BAT0";
+    if (!dev[0] || strchr(dev, '/')) {
+      fprintf(stderr, "Invalid --status battery=%s, use a power supply name (e.g. BAT0)\n", dev);
+      return false;
+    }
+    g.kind = STATUS_BATTERY;
+    g.period_ns = g.slack_ns = BATTERY_PERIOD_NS;
+    snprintf(path, sizeof(path), POWER_SUPPLY_DIR "/%s/capacity", dev);
+    if ((g.fd[0] = open_source(path)) < 0) return false;
+    snprintf(path, sizeof(path), POWER_SUPPLY_DIR "/%s/status", dev);
+    g.fd[1] = open(path, O_RDONLY | O_CLOEXEC);  // optional
+  } else if (strcmp(name, "countdown") == 0) {
+    int h, m;
+    char end;
+    if (!arg || sscanf(arg, "%d:%d%c", &h, &m, &end) != 2 || h < 0 || h > 23 || m < 0 || m > 59) {
+      fprintf(stderr, "Invalid --status countdown, use countdown=HH:MM\n");
+      return false;
+    }
+    g.kind = STATUS_COUNTDOWN;
+    g.period_ns = 60 * NS_PER_SEC;
+    g.target_min = h * 60 + m;
+  } else {
+    fprintf(stderr, "Unknown --status segment %s (use loadavg, battery[=NAME] or countdown=HH:MM)\n", name);
+    return false;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  refresh(&g, &now);
+  s->segs[s->n_segs] = g;
+  s->heap[s->n_heap] = (uint8_t)s->n_segs++;
+  heap_up(s, s->n_heap++);
+  return true;
+}
+
+bool status_add(status_t *s, const char *list) {
+  char buf[256];
+  if (strlen(list) >= sizeof(buf)) {
+    fprintf(stderr, "--status list too long\n");
+    return false;
+  }
+  memcpy(buf, list, strlen(list) + 1);
+  char *save = NULL;
+  for (char *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+    char *eq = strchr(tok, '=');
+    if (eq) *eq = '\0';
+    if (!add_one(s, tok, eq ? eq + 1 : NULL)) return false;
+  }
+  return true;
+}
+
+void status_flash(status_t *s, uint64_t count) {
+  status_seg_t *g = &s->segs[0];
+  if (count > 0) snprintf(g->text, sizeof(g->text), "(%llu)", (unsigned long long)count);
+  else g->text[0] = '\0';
+}
+
+bool status_update(status_t *s, const struct timespec *now) {
+  int64_t now_ns = (int64_t)now->tv_sec * NS_PER_SEC + now->tv_nsec;
+  bool changed = false;
+  // A handful of segments: check them all, then restore the heap once.
+  for (size_t i = 0; i < s->n_heap; ++i) {
+    status_seg_t *g = &s->segs[s->heap[i]];
+    // Due, or the clock stepped back past a whole period.
+    if (g->due_ns > now_ns && g->due_ns - now_ns <= g->period_ns) continue;
+    char old[STATUS_TEXT_MAX];
+    memcpy(old, g->text, sizeof(old));
+    refresh(g, now);
+    changed |= strcmp(old, g->text) != 0;
+  }
+  for (size_t i = s->n_heap / 2; i-- > 0; ) heap_down(s, i);
+  return changed;
+}
+
+bool status_next(const status_t *s, struct timespec *at) {
+  if (!s->n_heap) return false;
+  int64_t ns = deadline(&s->segs[s->heap[0]]);
+  *at = (struct timespec){ (time_t)(ns / NS_PER_SEC), (long)(ns % NS_PER_SEC) };
+  return true;
+}
+
+void status_append(const status_t *s, char *buf, size_t size) {
+  size_t len = strlen(buf);
+  for (size_t i = 0; i < s->n_segs && len + 1 < size; ++i) {
+    if (!s->segs[i].text[0]) continue;
+    int n = snprintf(buf + len, size - len, " %s", s->segs[i].text);
+    if (n < 0) break;
+    len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+  }
+}
+
+size_t status_max_width(const status_t *s, bool flash_count) {
+  size_t w = 0;
+  for (size_t i = 0; i < s->n_segs; ++i) {
+    switch (s->segs[i].kind) {
+      case STATUS_FLASH_COUNT: w += flash_count ? strlen(" ()") + STATUS_FLASH_DIGITS : 0; break;
+      case STATUS_BATTERY:     w += strlen(" 100%+"); break;
+      case STATUS_COUNTDOWN:   w += strlen(" T-23:59"); break;
+      default:                 w += 1 + STATUS_TEXT_MAX - 1; break;  // as read from /proc
+    }
+  }
+  return w;
+}
+
+void status_charset(const status_t *s, char *out, size_t size) {
+  bool set[128] = { false };
+  for (const char *p = out; *p; ++p) set[(unsigned char)*p & 0x7f] = true;
+  for (size_t i = 0; i < s->n_segs; ++i) {
+    const char *chars = "0123456789 ()";
+    if (s->segs[i].kind == STATUS_LOADAVG) chars = "0123456789 .";
+    else if (s->segs[i].kind == STATUS_BATTERY) chars = "0123456789 %+";
+    else if (s->segs[i].kind == STATUS_COUNTDOWN) chars = "0123456789 T-:";
+    for (const char *p = chars; *p; ++p) set[(unsigned char)*p] = true;
+  }
+  size_t n = 0;
+  for (int ch = 0x20; ch < 0x7f && n + 1 < size; ++ch) {
+    if (set[ch]) out[n++] = (char)ch;
+  }
+  if (size) out[n] = '\0';
+}
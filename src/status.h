@@ -0,0 +1,81 @@
+// status: extra segments shown after the clock, e.g. "--status
+// loadavg,battery,countdown=17:30". The flash count suffix is the first one.
+//
+// Each timed segment has a period (how often its value is worth fetching)
+// and a slack (how late it may be). Deadlines (due + slack) are kept in a
+// min-heap, and the main loop arms its one tick timer at the earliest of
+// that and the clock's next change. Any wakeup, clock ticks included,
+// refreshes every segment whose period has elapsed. A second-ticking clock
+// therefore carries all the segments, and the heap only adds wakeups when
+// the clock is slower than a segment's slack. A value that did not change
+// leaves the frame string, and so the window, untouched.
+//
+// Data sources (/proc, /sys) are opened once and re-read with pread.
+#ifndef STATUS_H
+#define STATUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define STATUS_SEGS_MAX 8
+#define STATUS_TEXT_MAX 24
+#define STATUS_FLASH_DIGITS 10
+
+typedef enum {
+  STATUS_FLASH_COUNT,  // "(N)" with --show-flash-count; event driven
+  STATUS_LOADAVG,      // 1-minute load average from /proc/loadavg
+  STATUS_BATTERY,      // capacity of /sys/class/power_supply/NAME, "+" while charging
+  STATUS_COUNTDOWN,    // time left until the next HH:MM, as "T-H:MM"
+} status_kind_t;
+
+typedef struct {
+  status_kind_t kind;
+  int fd[2];           // persistent sources read with pread, -1 if unused
+  int64_t period_ns;   // 0: refreshed by events only
+  int64_t slack_ns;
+  int64_t due_ns;      // realtime instant the value is next worth fetching
+  int target_min;      // countdown: minute of the day it counts down to
+  time_t target_at;    // countdown: the next such instant
+  char text[STATUS_TEXT_MAX];  // empty: not shown
+} status_seg_t;
+
+typedef struct {
+  status_seg_t segs[STATUS_SEGS_MAX];
+  size_t n_segs;
+  uint8_t heap[STATUS_SEGS_MAX];  // timed segments, earliest deadline first
+  size_t n_heap;
+} status_t;
+
+// Starts with the flash count segment only.
+void status_init(status_t *s);
+void status_destroy(status_t *s);
+
+// Adds the segments of a comma-separated list: loadavg, battery[=NAME]
+// (default BAT0) and countdown=HH:MM. Prints the problem and returns false
+// if a name is unknown or its source cannot be opened.
+bool status_add(status_t *s, const char *list);
+
+// Sets the flash count shown (0 hides it).
+void status_flash(status_t *s, uint64_t count);
+
+// Refreshes the timed segments whose period has elapsed at now. Returns
+// whether any text changed.
+bool status_update(status_t *s, const struct timespec *now);
+
+// Earliest deadline of a timed segment. Returns false if there is none.
+bool status_next(const status_t *s, struct timespec *at);
+
+// Appends " TEXT" for every shown segment to the NUL-terminated buf.
+void status_append(const status_t *s, char *buf, size_t size);
+
+// Widest suffix status_append can add, the flash count only if flash_count
+// (--show-flash-count) and then up to STATUS_FLASH_DIGITS digits.
+size_t status_max_width(const status_t *s, bool flash_count);
+
+// Adds the characters the segments can produce to the NUL-terminated
+// character set in out (as built by timefmt_charset).
+void status_charset(const status_t *s, char *out, size_t size);
+
+#endif
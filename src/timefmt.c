@@ -0,0 +1,685 @@
+// timefmt: compiled clock templates and incremental formatting. See timefmt.h.
+#define _POSIX_C_SOURCE 200809L
+#include "timefmt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "overlay.h"
+
+#define TZ_DIR "/etc"
+#define TZ_NAME "localtime"
+#define TZ_PATH TZ_DIR "/" TZ_NAME
+#define ZONEINFO_DIR "/usr/share/zoneinfo"
+#define ZONE_HORIZON (366 * 86400)  // how far ahead a transition is searched
+
+enum seg_kind {
+  SEG_LITERAL,
+  SEG_YEAR,      // %Y
+  SEG_YEAR2,     // %y
+  SEG_MONTH,     // %m
+  SEG_MDAY,      // %d
+  SEG_MDAY_SP,   // %e
+  SEG_HOUR,      // %H
+  SEG_HOUR_SP,   // %k
+  SEG_HOUR12,    // %I
+  SEG_HOUR12_SP, // %l
+  SEG_MIN,       // %M
+  SEG_SEC,       // %S
+  SEG_MS,        // %{ms}
+  SEG_CS,        // %{cs}
+  SEG_FLASH,     // %{flash}
+  SEG_STRFTIME,  // names, weeks...: strftime of a single conversion
+};
+
+// Conversions formatted arithmetically, or through strftime with a known
+// update frequency. Anything else is rejected at startup.
+static const struct {
+  char conv;
+  uint8_t kind;
+  uint8_t unit;
+} convs[] = {
+  { 'Y', SEG_YEAR, TF_UNIT_DAY },       { 'y', SEG_YEAR2, TF_UNIT_DAY },
+  { 'm', SEG_MONTH, TF_UNIT_DAY },      { 'd', SEG_MDAY, TF_UNIT_DAY },
+  { 'e', SEG_MDAY_SP, TF_UNIT_DAY },    { 'H', SEG_HOUR, TF_UNIT_HOUR },
+  { 'k', SEG_HOUR_SP, TF_UNIT_HOUR },   { 'I', SEG_HOUR12, TF_UNIT_HOUR },
+  { 'l', SEG_HOUR12_SP, TF_UNIT_HOUR }, { 'M', SEG_MIN, TF_UNIT_MIN },
+  { 'S', SEG_SEC, TF_UNIT_SEC },
+  { 'a', SEG_STRFTIME, TF_UNIT_DAY },   { 'A', SEG_STRFTIME, TF_UNIT_DAY },
+  { 'b', SEG_STRFTIME, TF_UNIT_DAY },   { 'B', SEG_STRFTIME, TF_UNIT_DAY },
+  { 'h', SEG_STRFTIME, TF_UNIT_DAY },   { 'C', SEG_STRFTIME, TF_UNIT_DAY },
+  { 'j', SEG_STRFTIME, TF_UNIT_DAY },   { 'u', SEG_STRFTIME, TF_UNIT_DAY },
+  { 'w', SEG_STRFTIME, TF_UNIT_DAY },   { 'U', SEG_STRFTIME, TF_UNIT_DAY },
+  { 'W', SEG_STRFTIME, TF_UNIT_DAY },   { 'V', SEG_STRFTIME, TF_UNIT_DAY },
+  { 'G', SEG_STRFTIME, TF_UNIT_DAY },   { 'g', SEG_STRFTIME, TF_UNIT_DAY },
+  { 'p', SEG_STRFTIME, TF_UNIT_HOUR },  { 'P', SEG_STRFTIME, TF_UNIT_HOUR },
+  { 'z', SEG_STRFTIME, TF_UNIT_MIN },   { 'Z', SEG_STRFTIME, TF_UNIT_MIN },
+};
+
+// Composite conversions, compiled as their expansion.
+static const struct {
+  char conv;
+  const char *expansion;
+} expansions[] = {
+  { 'T', "%H:%M:%S" }, { 'R', "%H:%M" }, { 'F', "%Y-%m-%d" }, { 'D', "%m/%d/%y" },
+};
+
+static bool add_seg(timefmt_t *f, uint8_t kind, uint8_t unit, char conv) {
+  if (f->n_segs >= TIMEFMT_SEGS_MAX) return false;
+  f->segs[f->n_segs++] = (tf_seg_t){ .kind = kind, .unit = unit, .conv = conv };
+  if (unit < f->unit) f->unit = unit;
+  if (kind == SEG_FLASH) f->has_flash = true;
+  return true;
+}
+
+static bool add_literal(timefmt_t *f, char ch) {
+  if (f->n_lits >= sizeof(f->lits)) return false;
+  tf_seg_t *last = f->n_segs ? &f->segs[f->n_segs - 1] : NULL;
+  if (!last || last->kind != SEG_LITERAL) {
+    if (!add_seg(f, SEG_LITERAL, TF_UNIT_NEVER, 0)) return false;
+    last = &f->segs[f->n_segs - 1];
+    last->lit_off = (uint16_t)f->n_lits;
+  }
+  f->lits[f->n_lits++] = ch;
+  last->lit_len++;
+  return true;
+}
+
+static bool compile(timefmt_t *f, const char *fmt) {
+  for (const char *p = fmt; *p; ++p) {
+    if (*p != '%') {
+      if (!add_literal(f, *p)) goto too_long;
+      continue;
+    }
+    char c = *++p;
+    if (c == '%') {
+      if (!add_literal(f, '%')) goto too_long;
+      continue;
+    }
+    if (c == '{') {
+      const char *name = p + 1;
+      const char *close = strchr(name, '}');
+      size_t len = close ? (size_t)(close - name) : 0;
+      bool ok;
+      if (close && len == 5 && strncmp(name, "flash", 5) == 0) ok = add_seg(f, SEG_FLASH, TF_UNIT_NEVER, 0);
+      else if (close && len == 4 && strncmp(name, "week", 4) == 0) ok = add_seg(f, SEG_STRFTIME, TF_UNIT_DAY, 'V');
+      else if (close && len == 2 && strncmp(name, "ms", 2) == 0) ok = add_seg(f, SEG_MS, TF_UNIT_SUBSEC, 0);
+      else if (close && len == 2 && strncmp(name, "cs", 2) == 0) ok = add_seg(f, SEG_CS, TF_UNIT_SUBSEC, 0);
+      else {
+        fprintf(stderr, "Unknown field %%{%.*s} in --format (use flash, week, ms or cs)\n",
+                close ? (int)len : (int)strlen(name), name);
+        return false;
+      }
+      if (!ok) goto too_long;
+      p = close;
+      continue;
+    }
+    bool found = false;
+    for (size_t i = 0; i < sizeof(expansions) / sizeof(expansions[0]) && !found; ++i) {
+      if (expansions[i].conv != c) continue;
+      if (!compile(f, expansions[i].expansion)) return false;
+      found = true;
+    }
+    for (size_t i = 0; i < sizeof(convs) / sizeof(convs[0]) && !found; ++i) {
+      if (convs[i].conv != c) continue;
+      if (!add_seg(f, convs[i].kind, convs[i].unit, c)) goto too_long;
+      found = true;
+    }
+    if (!found) {
+      if (c) fprintf(stderr, "Unsupported conversion %%%c in --format\n", c);
+      else fprintf(stderr, "Trailing %% in --format\n");
+      return false;
+    }
+  }
+  return true;
+
+too_long:
+  fprintf(stderr, "--format is too long (max %d segments, %zu literal characters)\n",
+          TIMEFMT_SEGS_MAX, sizeof(f->lits));
+  return false;
+}
+
+static char *put_digits(char *p, int v, int width) {
+  for (int i = width - 1; i >= 0; --i) {
+    p[i] = (char)('0' + v % 10);
+    v /= 10;
+  }
+  return p + width;
+}
+
+// Two digits, with a leading space instead of a zero if pad_space.
+static char *put_2(char *p, int v, bool pad_space) {
+  put_digits(p, v, 2);
+  if (pad_space && v < 10) p[0] = ' ';
+  return p + 2;
+}
+
+// Width of the arithmetic fields that always print the same number of
+// characters; 0 for the variable-width ones.
+static size_t fixed_width(uint8_t kind) {
+  switch (kind) {
+    case SEG_LITERAL: case SEG_YEAR: case SEG_FLASH: case SEG_STRFTIME: return 0;
+    case SEG_MS: return 3;
+    default: return 2;
+  }
+}
+
+static char *put_str(char *p, char *end, const char *s) {
+  for (; *s && p < end; ++s) *p++ = *s;
+  return p;
+}
+
+// Appends one segment of clock k at p (never past end) and returns the new end.
+static char *render_seg(const timefmt_t *f, const tf_clock_t *k, const tf_seg_t *g, char *p, char *end) {
+  const struct tm *tm = &k->tm;
+  size_t room = (size_t)(end - p);
+  int h12 = tm->tm_hour % 12 ? tm->tm_hour % 12 : 12;
+  if (room < fixed_width(g->kind)) return p;
+  switch ((enum seg_kind)g->kind) {
+    case SEG_LITERAL: {
+      size_t n = g->lit_len < room ? g->lit_len : room;
+      memcpy(p, f->lits + g->lit_off, n);
+      return p + n;
+    }
+    case SEG_YEAR: {
+      int year = tm->tm_year + 1900;
+      if (year >= 0 && year <= 9999 && room >= 4) return put_digits(p, year, 4);
+      int n = snprintf(p, room + 1, "%d", year);
+      return p + ((size_t)n < room ? (size_t)n : room);
+    }
+    case SEG_YEAR2:     return put_2(p, (tm->tm_year + 1900) % 100, false);
+    case SEG_MONTH:     return put_2(p, tm->tm_mon + 1, false);
+    case SEG_MDAY:      return put_2(p, tm->tm_mday, false);
+    case SEG_MDAY_SP:   return put_2(p, tm->tm_mday, true);
+    case SEG_HOUR:      return put_2(p, tm->tm_hour, false);
+    case SEG_HOUR_SP:   return put_2(p, tm->tm_hour, true);
+    case SEG_HOUR12:    return put_2(p, h12, false);
+    case SEG_HOUR12_SP: return put_2(p, h12, true);
+    case SEG_MIN:       return put_2(p, tm->tm_min, false);
+    case SEG_SEC:       return put_2(p, tm->tm_sec, false);
+    case SEG_MS:        return put_digits(p, f->ms, 3);
+    case SEG_CS:        return put_digits(p, f->ms / 10, 2);
+    case SEG_FLASH: {
+      int n = snprintf(p, room + 1, "%llu", (unsigned long long)f->flash_count);
+      return p + ((size_t)n < room ? (size_t)n : room);
+    }
+    case SEG_STRFTIME: {
+      // strftime only knows the process zone; a --zone has its own.
+      if (k->zone[0] && g->conv == 'Z') return put_str(p, end, k->abbr);
+      if (k->zone[0] && g->conv == 'z') {
+        long a = k->utcoff < 0 ? -k->utcoff : k->utcoff;
+        if (room < 5) return p;
+        *p = k->utcoff < 0 ? '-' : '+';
+        p = put_2(p + 1, (int)(a / 3600), false);
+        return put_2(p, (int)(a / 60 % 60), false);
+      }
+      char conv[3] = { '%', g->conv, '\0' };
+      return p + strftime(p, room + 1, conv, tm);
+    }
+  }
+  return p;
+}
+
+// Full render of the string from every clock's tm, recording where each
+// segment landed.
+static void render_full(timefmt_t *f) {
+  char *p = f->buf;
+  char *end = f->buf + sizeof(f->buf) - 1;
+  for (size_t c = 0; c < f->n_clocks; ++c) {
+    tf_clock_t *k = &f->clocks[c];
+    if (k->zone[0]) {
+      p = put_str(p, end, TIMEFMT_ZONE_SEP);
+      p = put_str(p, end, k->abbr);
+      p = put_str(p, end, " ");
+    }
+    for (size_t i = 0; i < f->n_segs; ++i) {
+      k->off[i] = (uint16_t)(p - f->buf);
+      p = render_seg(f, k, &f->segs[i], p, end);
+      k->len[i] = (uint16_t)(p - f->buf - k->off[i]);
+    }
+  }
+  *p = '\0';
+}
+
+// Within a minute only the seconds and sub-second digits move; all are fixed
+// width, so they are rewritten in place at the offsets of the last full render.
+static void render_fast(timefmt_t *f) {
+  for (size_t c = 0; c < f->n_clocks; ++c) {
+    const tf_clock_t *k = &f->clocks[c];
+    for (size_t i = 0; i < f->n_segs; ++i) {
+      uint8_t kind = f->segs[i].kind;
+      char *at = f->buf + k->off[i];
+      if (kind == SEG_SEC && k->len[i] == 2) put_2(at, k->tm.tm_sec, false);
+      else if (kind == SEG_MS && k->len[i] == 3) put_digits(at, f->ms, 3);
+      else if (kind == SEG_CS && k->len[i] == 2) put_digits(at, f->ms / 10, 2);
+    }
+  }
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date, and back (H. Hinnant's
+// civil calendar algorithms): a zone's broken-down time is plain arithmetic.
+static int64_t days_from_civil(int64_t y, int m, int d) {
+  y -= m <= 2;
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  int64_t yoe = y - era * 400;
+  int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+static void civil_tm(time_t t, long utcoff, struct tm *tm) {
+  int64_t s = (int64_t)t + utcoff;
+  int64_t days = s / 86400, sod = s % 86400;
+  if (sod < 0) {
+    sod += 86400;
+    days--;
+  }
+  int64_t z = days + 719468;
+  int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  int64_t doe = z - era * 146097;
+  int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int64_t doy = doe - (yoe * 365 + yoe / 4 - yoe / 100);  // from March 1
+  int64_t mp = (doy * 5 + 2) / 153;
+  int64_t y = yoe + era * 400 + (mp >= 10);
+  bool leap = y % 4 == 0 && (y % 100 != 0 || y % 400 == 0);
+  *tm = (struct tm){
+    .tm_sec = (int)(sod % 60),
+    .tm_min = (int)(sod / 60 % 60),
+    .tm_hour = (int)(sod / 3600),
+    .tm_mday = (int)(doy - (mp * 153 + 2) / 5 + 1),
+    .tm_mon = (int)(mp < 10 ? mp + 2 : mp - 10),
+    .tm_year = (int)(y - 1900),
+    .tm_wday = (int)((days % 7 + 11) % 7),  // 1970-01-01 was a Thursday
+    .tm_yday = (int)(mp < 10 ? doy + 59 + leap : doy - 306),
+  };
+}
+
+// Offset east of UTC at t of the zone currently in TZ, and its abbreviation.
+static long zone_probe(time_t t, char *abbr, size_t size) {
+  struct tm tm;
+  if (!localtime_r(&t, &tm)) {
+    snprintf(abbr, size, "UTC");
+    return 0;
+  }
+  if (!strftime(abbr, size, "%Z", &tm)) abbr[0] = '\0';
+  int64_t local = days_from_civil(tm.tm_year + 1900LL, tm.tm_mon + 1, tm.tm_mday) * 86400 +
+                  tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+  return (long)(local - (int64_t)t);
+}
+
+// Looks up the offset and abbreviation of k's zone at t and the next
+// instant either changes: day steps up to a year ahead, then bisection to
+// the second. localtime_r only knows the process zone, so TZ is switched for
+// the duration; this runs at startup and at the zone's transitions only
+// (timefmt_zones_due).
+static void zone_refresh(tf_clock_t *k, time_t t) {
+  const char *cur = getenv("TZ");
+  char *saved = cur ? strdup(cur) : NULL;
+  char tz[TIMEFMT_ZONE_NAME + 1];
+  snprintf(tz, sizeof(tz), ":%s", k->zone);
+  setenv("TZ", tz, 1);
+  tzset();
+
+  k->utcoff = zone_probe(t, k->abbr, sizeof(k->abbr));
+  k->since = t;
+  k->until = t + ZONE_HORIZON;
+  memcpy(k->next_abbr, k->abbr, sizeof(k->abbr));
+  char abbr[TIMEFMT_ABBR];
+  for (time_t lo = t, hi = t + 86400; hi <= t + ZONE_HORIZON; lo = hi, hi += 86400) {
+    if (zone_probe(hi, abbr, sizeof(abbr)) == k->utcoff && strcmp(abbr, k->abbr) == 0) continue;
+    while (hi - lo > 1) {
+      time_t mid = lo + (hi - lo) / 2;
+      if (zone_probe(mid, abbr, sizeof(abbr)) == k->utcoff && strcmp(abbr, k->abbr) == 0) lo = mid;
+      else hi = mid;
+    }
+    k->until = hi;
+    zone_probe(hi, k->next_abbr, sizeof(k->next_abbr));
+    break;
+  }
+
+  if (saved) setenv("TZ", saved, 1);
+  else unsetenv("TZ");
+  free(saved);
+  tzset();
+}
+
+// Recomputes clock k's broken-down time for a new minute at t.
+static void clock_minute(tf_clock_t *k, time_t t) {
+  if (!k->zone[0]) {
+    localtime_r(&t, &k->tm);
+    // A leap second shows as :60; clamp so the minute arithmetic holds.
+    if (k->tm.tm_sec > 59) k->tm.tm_sec = 59;
+  } else {
+    if (t < k->since || t >= k->until) zone_refresh(k, t);
+    civil_tm(t, k->utcoff, &k->tm);
+  }
+  k->minute_start = t - k->tm.tm_sec;
+  k->valid = true;
+}
+
+static void watch_zone_file(timefmt_t *f) {
+  // Follows the symlink, so in-place tzdata updates of the target are seen too.
+  f->tz_file_wd = inotify_add_watch(f->tz_fd, TZ_PATH,
+                                    IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF);
+}
+
+bool timefmt_init(timefmt_t *f, const char *format) {
+  memset(f, 0, sizeof(*f));
+  f->tz_fd = -1;
+  f->tz_file_wd = -1;
+  f->unit = TF_UNIT_NEVER;
+  f->subsec_ns = TIMEFMT_SUBSEC_NS;
+  f->n_clocks = 1;
+  if (!compile(f, format)) return false;
+  tzset();
+  if (timefmt_max_width(f) >= sizeof(f->buf)) {
+    fprintf(stderr, "--format can produce %zu characters (max %zu)\n", timefmt_max_width(f),
+            sizeof(f->buf) - 1);
+    return false;
+  }
+
+  // /etc/localtime is usually a symlink swapped atomically (timedatectl,
+  // ln -sf), so watch the directory entry as well as the file itself.
+  f->tz_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (f->tz_fd >= 0) {
+    if (inotify_add_watch(f->tz_fd, TZ_DIR, IN_CREATE | IN_MOVED_TO | IN_DELETE | IN_CLOSE_WRITE) < 0) {
+      close(f->tz_fd);
+      f->tz_fd = -1;
+      return true;
+    }
+    watch_zone_file(f);
+  }
+  return true;
+}
+
+void timefmt_destroy(timefmt_t *f) {
+  if (f->tz_fd >= 0) close(f->tz_fd);
+  f->tz_fd = -1;
+}
+
+// glibc silently falls back to UTC for a TZ it cannot load, so check the
+// zone file exists first.
+static bool zone_exists(const char *zone) {
+  if (strcmp(zone, "UTC") == 0 || strcmp(zone, "GMT") == 0) return true;
+  if (zone[0] == '/') return access(zone, R_OK) == 0;
+  if (strstr(zone, "..")) return false;
+  const char *dir = getenv("TZDIR");
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", dir && dir[0] ? dir : ZONEINFO_DIR, zone);
+  struct stat sb;
+  return stat(path, &sb) == 0 && S_ISREG(sb.st_mode);
+}
+
+bool timefmt_add_zone(timefmt_t *f, const char *zone) {
+  if (f->n_clocks > TIMEFMT_ZONES_MAX) {
+    fprintf(stderr, "Too many --zone (max %d)\n", TIMEFMT_ZONES_MAX);
+    return false;
+  }
+  if (!zone[0] || strlen(zone) >= TIMEFMT_ZONE_NAME || !zone_exists(zone)) {
+    fprintf(stderr, "Unknown timezone for --zone: %s\n", zone);
+    return false;
+  }
+  tf_clock_t *k = &f->clocks[f->n_clocks++];
+  memset(k, 0, sizeof(*k));
+  memcpy(k->zone, zone, strlen(zone) + 1);
+  time_t now = time(NULL);
+  zone_refresh(k, now);
+  // Rejected rather than cut short when the labels come in.
+  size_t w = timefmt_max_width(f);
+  if (w >= sizeof(f->buf)) {
+    fprintf(stderr, "--zone %s does not fit: the clock string can reach %zu characters (max %zu)\n",
+            zone, w, sizeof(f->buf) - 1);
+    f->n_clocks--;
+    return false;
+  }
+  return true;
+}
+
+// Widest output of one strftime conversion over the values it can take.
+static size_t strftime_width(char conv) {
+  char fmt[3] = { '%', conv, '\0' };
+  char tmp[64];
+  struct tm tm = { .tm_year = 100, .tm_mday = 1 };
+  size_t w = 0, n;
+  if (strchr("aA", conv)) {
+    for (tm.tm_wday = 0; tm.tm_wday < 7; ++tm.tm_wday)
+      if ((n = strftime(tmp, sizeof(tmp), fmt, &tm)) > w) w = n;
+  } else if (strchr("bBh", conv)) {
+    for (tm.tm_mon = 0; tm.tm_mon < 12; ++tm.tm_mon)
+      if ((n = strftime(tmp, sizeof(tmp), fmt, &tm)) > w) w = n;
+  } else if (strchr("pP", conv)) {
+    for (tm.tm_hour = 0; tm.tm_hour < 24; tm.tm_hour += 12)
+      if ((n = strftime(tmp, sizeof(tmp), fmt, &tm)) > w) w = n;
+  } else {
+    // Numbers of a fixed number of digits: C, j, u, w, U, W, V, G, g.
+    w = strftime(tmp, sizeof(tmp), fmt, &tm);
+  }
+  return w;
+}
+
+static size_t max_len(const char *a, const char *b) {
+  size_t la = strlen(a), lb = strlen(b);
+  return la > lb ? la : lb;
+}
+
+size_t timefmt_max_width(const timefmt_t *f) {
+  size_t total = 0;
+  for (size_t c = 0; c < f->n_clocks; ++c) {
+    const tf_clock_t *k = &f->clocks[c];
+    if (k->zone[0]) total += strlen(TIMEFMT_ZONE_SEP) + max_len(k->abbr, k->next_abbr) + 1;
+    for (size_t i = 0; i < f->n_segs; ++i) {
+      const tf_seg_t *g = &f->segs[i];
+      switch ((enum seg_kind)g->kind) {
+        case SEG_LITERAL: total += g->lit_len; break;
+        case SEG_YEAR:    total += 4; break;
+        case SEG_FLASH:   total += TIMEFMT_FLASH_DIGITS; break;
+        case SEG_STRFTIME:
+          if (g->conv == 'Z') total += k->zone[0] ? max_len(k->abbr, k->next_abbr) : max_len(tzname[0], tzname[1]);
+          else if (g->conv == 'z') total += 5;
+          else total += strftime_width(g->conv);
+          break;
+        default: total += fixed_width(g->kind); break;
+      }
+    }
+  }
+  return total;
+}
+
+bool timefmt_zones_due(const timefmt_t *f, time_t t) {
+  for (size_t c = 1; c < f->n_clocks; ++c) {
+    if (t < f->clocks[c].since || t >= f->clocks[c].until) return true;
+  }
+  return false;
+}
+
+const char *timefmt_update(timefmt_t *f, const struct timespec *now, uint64_t flash_count,
+                           struct tm *tm_out) {
+  time_t t = now->tv_sec;
+  bool full = false;
+  for (size_t c = 0; c < f->n_clocks; ++c) {
+    tf_clock_t *k = &f->clocks[c];
+    if (k->valid && t >= k->minute_start && t < k->minute_start + 60 && (!k->zone[0] || t < k->until)) {
+      // Same minute: only the seconds digits move.
+      k->tm.tm_sec = (int)(t - k->minute_start);
+    } else {
+      // Minute/hour/day rollover, DST transition (always on a minute
+      // boundary) or a clock jump: recompute the broken-down time.
+      clock_minute(k, t);
+      full = true;
+    }
+  }
+  f->ms = (int)(now->tv_nsec / 1000000);
+  if (f->has_flash && flash_count != f->flash_count) full = true;  // may change width
+  f->flash_count = flash_count;
+  if (full) render_full(f);
+  else render_fast(f);
+  if (tm_out) *tm_out = f->clocks[0].tm;
+  return f->buf;
+}
+
+// Next hour or day boundary of zone clock k after its current minute; its
+// offset is fixed until k->until, which is a change of its own.
+static time_t zone_next_change(const tf_clock_t *k, tf_unit_t unit) {
+  time_t next = k->minute_start + 60;
+  if (unit == TF_UNIT_HOUR) next = k->minute_start - k->tm.tm_min * 60 + 3600;
+  else if (unit == TF_UNIT_DAY) next = k->minute_start - k->tm.tm_hour * 3600 - k->tm.tm_min * 60 + 86400;
+  return next < k->until ? next : k->until;
+}
+
+bool timefmt_next_change(const timefmt_t *f, const struct timespec *now, struct timespec *at) {
+  const tf_clock_t *local = &f->clocks[0];
+  time_t t = now->tv_sec;
+  time_t minute_end = (local->valid ? local->minute_start : t - t % 60) + 60;
+  struct tm n = local->tm;
+  n.tm_sec = 0;
+  n.tm_min = 0;
+  n.tm_isdst = -1;
+  time_t next;
+  switch (f->unit) {
+    case TF_UNIT_SUBSEC: {
+      long ns = (long)((now->tv_nsec / f->subsec_ns + 1) * f->subsec_ns);
+      *at = ns < NS_PER_SEC ? (struct timespec){ t, ns } : (struct timespec){ t + 1, 0 };
+      return true;
+    }
+    case TF_UNIT_SEC: next = t + 1; break;
+    case TF_UNIT_MIN: next = minute_end; break;
+    case TF_UNIT_HOUR:
+      // mktime, not arithmetic: zones with half-hour offsets or DST shifts
+      // do not put local hours on UTC hour multiples.
+      n.tm_hour++;
+      next = mktime(&n);
+      break;
+    case TF_UNIT_DAY:
+      n.tm_hour = 0;
+      n.tm_mday++;
+      next = mktime(&n);
+      break;
+    default:
+      return false;
+  }
+  // An ambiguous local time around a DST change can land mktime in the
+  // past; the minute boundary is always a safe next look.
+  if (next <= t || next == (time_t)-1) next = minute_end;
+  for (size_t c = 1; c < f->n_clocks && f->unit != TF_UNIT_SEC; ++c) {
+    if (!f->clocks[c].valid) continue;
+    time_t z = zone_next_change(&f->clocks[c], f->unit);
+    if (z > t && z < next) next = z;
+  }
+  *at = (struct timespec){ next, 0 };
+  return true;
+}
+
+static void add_chars(bool *set, const char *s) {
+  for (; *s; ++s) {
+    unsigned char ch = (unsigned char)*s;
+    if (ch >= 0x20 && ch < 0x7f) set[ch] = true;
+  }
+}
+
+void timefmt_charset(const timefmt_t *f, char *out, size_t size) {
+  bool set[128] = { false };
+  for (size_t i = 0; i < f->n_segs; ++i) {
+    const tf_seg_t *g = &f->segs[i];
+    char tmp[64];
+    struct tm tm = { .tm_year = 100, .tm_mday = 1 };
+    switch (g->kind) {
+      case SEG_LITERAL:
+        for (size_t k = 0; k < g->lit_len; ++k) {
+          unsigned char ch = (unsigned char)f->lits[g->lit_off + k];
+          if (ch >= 0x20 && ch < 0x7f) set[ch] = true;
+        }
+        break;
+      case SEG_MDAY_SP: case SEG_HOUR_SP: case SEG_HOUR12_SP:
+        add_chars(set, " 0123456789");
+        break;
+      case SEG_YEAR:
+        add_chars(set, "-0123456789");
+        break;
+      case SEG_STRFTIME: {
+        char conv[3] = { '%', g->conv, '\0' };
+        if (strchr("aA", g->conv)) {
+          for (tm.tm_wday = 0; tm.tm_wday < 7; ++tm.tm_wday)
+            if (strftime(tmp, sizeof(tmp), conv, &tm)) add_chars(set, tmp);
+        } else if (strchr("bBh", g->conv)) {
+          for (tm.tm_mon = 0; tm.tm_mon < 12; ++tm.tm_mon)
+            if (strftime(tmp, sizeof(tmp), conv, &tm)) add_chars(set, tmp);
+        } else if (strchr("pP", g->conv)) {
+          for (tm.tm_hour = 0; tm.tm_hour < 24; tm.tm_hour += 12)
+            if (strftime(tmp, sizeof(tmp), conv, &tm)) add_chars(set, tmp);
+        } else if (g->conv == 'Z') {
+          add_chars(set, tzname[0]);
+          add_chars(set, tzname[1]);
+          for (size_t c = 1; c < f->n_clocks; ++c) {
+            add_chars(set, f->clocks[c].abbr);
+            add_chars(set, f->clocks[c].next_abbr);
+          }
+        } else {
+          add_chars(set, "+-0123456789");
+        }
+      } break;
+      default:
+        add_chars(set, "0123456789");
+        break;
+    }
+  }
+  for (size_t c = 1; c < f->n_clocks; ++c) {
+    add_chars(set, TIMEFMT_ZONE_SEP " ");
+    add_chars(set, f->clocks[c].abbr);
+    add_chars(set, f->clocks[c].next_abbr);
+  }
+  size_t n = 0;
+  for (int ch = 0x20; ch < 0x7f && n + 1 < size; ++ch) {
+    if (set[ch]) out[n++] = (char)ch;
+  }
+  if (size) out[n] = '\0';
+}
+
+const char *timefmt_unit_name(tf_unit_t unit) {
+  switch (unit) {
+    case TF_UNIT_SUBSEC: return "sub-second";
+    case TF_UNIT_SEC:    return "second";
+    case TF_UNIT_MIN:    return "minute";
+    case TF_UNIT_HOUR:   return "hour";
+    case TF_UNIT_DAY:    return "day";
+    default:             return "never";
+  }
+}
+
+void timefmt_invalidate(timefmt_t *f) {
+  for (size_t c = 0; c < f->n_clocks; ++c) f->clocks[c].valid = false;
+}
+
+int timefmt_tz_fd(const timefmt_t *f) {
+  return f->tz_fd;
+}
+
+bool timefmt_handle_tz(timefmt_t *f) {
+  if (f->tz_fd < 0) return false;
+  char evbuf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool changed = false;
+  ssize_t n;
+  while ((n = read(f->tz_fd, evbuf, sizeof(evbuf))) > 0) {
+    for (char *p = evbuf; p < evbuf + n; ) {
+      const struct inotify_event *ie = (const struct inotify_event *)p;
+      if (ie->wd == f->tz_file_wd) {
+        changed = true;
+        if (ie->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) f->tz_file_wd = -1;
+      } else if (ie->len > 0 && strcmp(ie->name, TZ_NAME) == 0) {
+        changed = true;
+      }
+      p += sizeof(struct inotify_event) + ie->len;
+    }
+  }
+  if (changed) {
+    // The zone file may have been replaced; follow the new target.
+    if (f->tz_file_wd >= 0) inotify_rm_watch(f->tz_fd, f->tz_file_wd);
+    watch_zone_file(f);
+    tzset();
+    f->clocks[0].valid = false;
+  }
+  return changed;
+}
@@ -0,0 +1,137 @@
+// timefmt: compiled clock templates and incremental formatting.
+// The --format string is parsed once into a plan of segments, each knowing
+// how often it can change. The broken-down local time is only recomputed
+// (localtime_r) when the minute rolls over, the clock jumps or the timezone
+// changes; within a minute the seconds digits are bumped in place.
+//
+// The same plan can also be rendered for extra timezones (--zone), side by
+// side after the local time. Each zone keeps its UTC offset until its next
+// transition, so its minute rollovers are arithmetic on the one clock sample
+// rather than a localtime_r per zone.
+//
+// Looking a zone's offset up switches the TZ environment variable (see
+// timefmt_zones_due), so it must not overlap other threads reading the
+// environment. --zone clocks are added before any thread starts.
+#ifndef TIMEFMT_H
+#define TIMEFMT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define TIMEFMT_SEGS_MAX 32
+#define TIMEFMT_LITS 96
+#define TIMEFMT_BUF 128
+#define TIMEFMT_ZONES_MAX 4
+#define TIMEFMT_ZONE_NAME 64
+#define TIMEFMT_ABBR 16
+#define TIMEFMT_ZONE_SEP "  "  // between the clocks of the string
+#define TIMEFMT_SUBSEC_NS 100000000LL  // default refresh period of %{ms}, %{cs}
+#define TIMEFMT_FLASH_DIGITS 10  // %{flash} width budgeted by timefmt_max_width
+
+#define TIMEFMT_DEFAULT "%Y-%m-%d %H:%M:%S"
+#define TIMEFMT_TIME_ONLY "%H:%M:%S"
+
+// How often a segment (and so the whole string) can change, fastest first.
+typedef enum {
+  TF_UNIT_SUBSEC,
+  TF_UNIT_SEC,
+  TF_UNIT_MIN,
+  TF_UNIT_HOUR,
+  TF_UNIT_DAY,
+  TF_UNIT_NEVER,  // literals, and fields driven by events (flash count)
+} tf_unit_t;
+
+typedef struct {
+  uint8_t kind;      // seg_kind in timefmt.c
+  uint8_t unit;      // tf_unit_t
+  char conv;         // strftime conversion for strftime-backed segments
+  uint16_t lit_off, lit_len;
+} tf_seg_t;
+
+// One rendering of the plan: the local time (clocks[0]) or a --zone.
+typedef struct {
+  bool valid;          // tm describes the minute starting at minute_start
+  time_t minute_start;
+  struct tm tm;        // time of the last formatted second, in this zone
+  uint16_t off[TIMEFMT_SEGS_MAX], len[TIMEFMT_SEGS_MAX];  // segments in buf after the last full render
+
+  // Zones only (zone[0] is '\0' for the local clock): the offset and
+  // abbreviation in effect over [since, until), until being the next
+  // transition or a year ahead, whichever comes first.
+  char zone[TIMEFMT_ZONE_NAME];
+  char abbr[TIMEFMT_ABBR];       // label, e.g. "EDT"
+  char next_abbr[TIMEFMT_ABBR];  // the label from until on
+  long utcoff;                   // seconds east of UTC
+  time_t since, until;
+} tf_clock_t;
+
+typedef struct {
+  tf_seg_t segs[TIMEFMT_SEGS_MAX];
+  size_t n_segs;
+  char lits[TIMEFMT_LITS];
+  size_t n_lits;
+  tf_unit_t unit;      // fastest-changing segment
+  bool has_flash;
+  int64_t subsec_ns;   // tick period of sub-second segments
+
+  tf_clock_t clocks[1 + TIMEFMT_ZONES_MAX];
+  size_t n_clocks;
+  int ms;
+  uint64_t flash_count;
+  char buf[TIMEFMT_BUF];
+  int tz_fd;           // inotify fd watching /etc/localtime, -1 if unavailable
+  int tz_file_wd;      // watch on the zone file itself, -1 if none
+} timefmt_t;
+
+// Compiles format (strftime-like, see README) into f. Prints the problem and
+// returns false if it uses an unsupported conversion or is too long, in
+// segments or in the widest string it can produce (timefmt_max_width).
+bool timefmt_init(timefmt_t *f, const char *format);
+void timefmt_destroy(timefmt_t *f);
+
+// Adds a clock for zone (a tz database name such as "America/New_York"),
+// shown after the others as "ABBR time". Prints the problem and returns
+// false if the zone is unknown, TIMEFMT_ZONES_MAX are in use or the string
+// would no longer fit TIMEFMT_BUF.
+bool timefmt_add_zone(timefmt_t *f, const char *zone);
+
+// Widest string the plan can format, every zone included: names of the
+// current locale, the zones' current and next labels, years up to 9999 and
+// flash counts up to TIMEFMT_FLASH_DIGITS digits.
+size_t timefmt_max_width(const timefmt_t *f);
+
+// Whether formatting t looks up a zone's next transition, switching TZ for
+// the duration. Callers with threads that may read the environment (the
+// font worker) finish them first.
+bool timefmt_zones_due(const timefmt_t *f, time_t t);
+
+// Formats now (CLOCK_REALTIME) and returns the NUL-terminated clock string
+// (owned by f), every zone included. flash_count feeds %{flash}. If tm_out
+// is non-NULL it receives the broken-down local time of now.
+const char *timefmt_update(timefmt_t *f, const struct timespec *now, uint64_t flash_count,
+                           struct tm *tm_out);
+
+// Realtime instant at which the string last formatted for now next changes,
+// from the plan's fastest unit in any of its zones. Returns false if only events can change it.
+bool timefmt_next_change(const timefmt_t *f, const struct timespec *now, struct timespec *at);
+
+// Writes every printable ASCII character the plan can produce (digits,
+// literals, day/month names of the current locale, zone labels...) to out as a
+// NUL-terminated set, for sizing the glyph atlas.
+void timefmt_charset(const timefmt_t *f, char *out, size_t size);
+
+const char *timefmt_unit_name(tf_unit_t unit);
+
+// Forces a full recompute on the next update.
+void timefmt_invalidate(timefmt_t *f);
+
+// Pollable fd that becomes readable when /etc/localtime changes, -1 if
+// timezone changes cannot be watched.
+int timefmt_tz_fd(const timefmt_t *f);
+
+// Drains tz_fd and re-reads the timezone. Returns true if it changed.
+bool timefmt_handle_tz(timefmt_t *f);
+
+#endif
@@ -0,0 +1,125 @@
+// timefmt_test: checks timefmt's output against localtime_r + strftime for
+// fixed instants: both DST transitions of a few zones (Lord Howe shifts by
+// 30 minutes), leap days, year and minute rollovers. Each window is walked
+// second by second with several sub-second samples, so the in-place digit
+// updates are compared as well as the full renders. Run by meson test.
+#define _POSIX_C_SOURCE 200809L
+#include "timefmt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "overlay.h"
+
+#define SKIP 77  // meson: test skipped
+#define WINDOW 150  // seconds checked on each side of an instant
+
+static const char *const formats[] = {
+  "%a %F %T.%{ms} %Z %z",
+  "%j %u %V %G %e %k %I:%M:%S %l %p %b %y",
+};
+
+static const char *const zones[] = { "Europe/Berlin", "America/New_York", "Australia/Lord_Howe", "UTC" };
+
+static const struct {
+  const char *what;
+  time_t at;
+} instants[] = {
+  { "Berlin CEST starts", 1711846800 },   // 2024-03-31 01:00 UTC
+  { "Berlin CEST ends", 1729990800 },     // 2024-10-27 01:00 UTC
+  { "New York EDT starts", 1710054000 },  // 2024-03-10 07:00 UTC
+  { "New York EDT ends", 1730613600 },    // 2024-11-03 06:00 UTC
+  { "Lord Howe +11 ends", 1712415600 },   // 2024-04-06 15:00 UTC
+  { "Lord Howe +11 starts", 1728142200 }, // 2024-10-05 15:30 UTC
+  { "leap day", 1709164800 },             // 2024-02-29 00:00 UTC
+  { "after a leap day", 1709251200 },     // 2024-03-01 00:00 UTC
+  { "new year", 1735689600 },             // 2025-01-01 00:00 UTC
+  { "century leap day", 951782400 },      // 2000-02-29 00:00 UTC
+  { "century without one", 4107542400 },  // 2100-03-01 00:00 UTC
+};
+
+static void use_zone(const char *zone) {
+  char tz[TIMEFMT_ZONE_NAME + 1];
+  snprintf(tz, sizeof(tz), ":%s", zone);
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+// fmt as formatted by strftime in zone at t, %{ms} substituted first.
+static void expect_clock(const char *fmt, const char *zone, time_t t, int ms, char *out, size_t size) {
+  char sub[256], digits[4];
+  snprintf(digits, sizeof(digits), "%03d", ms);
+  size_t n = 0;
+  for (const char *p = fmt; *p && n + 4 < sizeof(sub); ) {
+    if (strncmp(p, "%{ms}", 5) == 0) {
+      memcpy(sub + n, digits, 3);
+      n += 3;
+      p += 5;
+    } else {
+      sub[n++] = *p++;
+    }
+  }
+  sub[n] = '\0';
+  use_zone(zone);
+  struct tm tm;
+  localtime_r(&t, &tm);
+  size_t len = strftime(out, size, sub, &tm);
+  out[len] = '\0';
+}
+
+// The local clock, then the same zone again as a --zone clock: one string
+// checks both the localtime_r path and the offset arithmetic.
+static void expect(const char *fmt, const char *zone, time_t t, int ms, char *out, size_t size) {
+  char local[128], other[128], abbr[TIMEFMT_ABBR];
+  expect_clock(fmt, zone, t, ms, local, sizeof(local));
+  expect_clock(fmt, zone, t, ms, other, sizeof(other));
+  expect_clock("%Z", zone, t, 0, abbr, sizeof(abbr));
+  snprintf(out, size, "%s" TIMEFMT_ZONE_SEP "%s %s", local, abbr, other);
+}
+
+static int check_window(const char *fmt, const char *zone, const char *what, time_t at) {
+  use_zone(zone);
+  timefmt_t f;
+  if (!timefmt_init(&f, fmt) || !timefmt_add_zone(&f, zone)) {
+    fprintf(stderr, "FAIL: cannot set up \"%s\" in %s\n", fmt, zone);
+    return 1;
+  }
+  int failures = 0;
+  for (time_t t = at - WINDOW; t <= at + WINDOW && failures < 5; ++t) {
+    for (long ns = 4567; ns < NS_PER_SEC; ns += 333333333) {
+      struct timespec now = { t, ns };
+      use_zone(zone);
+      const char *got = timefmt_update(&f, &now, 0, NULL);
+      char want[TIMEFMT_BUF * 3];
+      expect(fmt, zone, t, (int)(ns / 1000000), want, sizeof(want));
+      if (strcmp(got, want) != 0) {
+        fprintf(stderr, "FAIL: %s, %s at %lld.%09ld, \"%s\"\n  got  \"%s\"\n  want \"%s\"\n", what, zone,
+                (long long)t, ns, fmt, got, want);
+        failures++;
+      }
+    }
+  }
+  timefmt_destroy(&f);
+  return failures;
+}
+
+int main(void) {
+  if (access("/usr/share/zoneinfo/Australia/Lord_Howe", R_OK) != 0) {
+    fprintf(stderr, "no tz database, skipping\n");
+    return SKIP;
+  }
+  int failures = 0;
+  size_t checked = 0;
+  for (size_t i = 0; i < sizeof(instants) / sizeof(instants[0]); ++i) {
+    for (size_t z = 0; z < sizeof(zones) / sizeof(zones[0]); ++z) {
+      for (size_t k = 0; k < sizeof(formats) / sizeof(formats[0]); ++k) {
+        failures += check_window(formats[k], zones[z], instants[i].what, instants[i].at);
+        checked++;
+      }
+    }
+  }
+  printf("%zu windows checked, %d mismatches\n", checked, failures);
+  return failures ? 1 : 0;
+}
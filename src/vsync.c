@@ -0,0 +1,61 @@
+// vsync: display-refresh pacing with the Present extension. See vsync.h.
+#define _POSIX_C_SOURCE 200809L
+#include "vsync.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool vsync_init(vsync_t *v, xcb_connection_t *c) {
+  memset(v, 0, sizeof(*v));
+  const xcb_query_extension_reply_t *ext = xcb_get_extension_data(c, &xcb_present_id);
+  if (!ext || !ext->present) return false;
+  xcb_present_query_version_reply_t *r =
+    xcb_present_query_version_reply(c, xcb_present_query_version(c, 1, 0), NULL);
+  bool ok = r != NULL;
+  free(r);
+  if (!ok) return false;
+  v->present = true;
+  v->opcode = ext->major_opcode;
+  return true;
+}
+
+void vsync_target(vsync_t *v, xcb_connection_t *c, xcb_window_t win) {
+  if (!v->present || win == v->win) return;
+  // The old window's event context went away with the window; a request
+  // pending on it will never complete.
+  v->win = win;
+  v->eid = xcb_generate_id(c);
+  xcb_present_select_input(c, v->eid, win, XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+  v->pending = false;
+  vsync_reset(v);
+}
+
+void vsync_request(vsync_t *v, xcb_connection_t *c) {
+  if (!v->present || !v->win || v->pending) return;
+  // divisor 0: complete once MSC >= target, i.e. right away (with the
+  // current MSC) if the target already went by. That is what counts misses.
+  v->target_msc = v->last_msc ? v->last_msc + 1 : 0;
+  xcb_present_notify_msc(c, v->win, ++v->serial, v->target_msc, 0, 0);
+  v->pending = true;
+}
+
+void vsync_reset(vsync_t *v) {
+  v->last_msc = 0;
+}
+
+bool vsync_handle_event(vsync_t *v, const xcb_generic_event_t *ev, bool *frame) {
+  *frame = false;
+  if (!v->present || (ev->response_type & 0x7f) != XCB_GE_GENERIC) return false;
+  const xcb_ge_generic_event_t *ge = (const xcb_ge_generic_event_t *)ev;
+  if (ge->extension != v->opcode) return false;
+  if (ge->event_type != XCB_PRESENT_EVENT_COMPLETE_NOTIFY) return true;
+
+  const xcb_present_complete_notify_event_t *cn = (const xcb_present_complete_notify_event_t *)ev;
+  if (cn->kind != XCB_PRESENT_COMPLETE_KIND_NOTIFY_MSC || !v->pending || cn->serial != v->serial) return true;
+  if (v->target_msc && cn->msc > v->target_msc) v->missed += cn->msc - v->target_msc;
+  v->last_msc = cn->msc;
+  v->pending = false;
+  v->frames++;
+  *frame = true;
+  return true;
+}
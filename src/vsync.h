@@ -0,0 +1,47 @@
+// vsync: display-refresh pacing with the Present extension, for
+// --precision. A PresentNotifyMSC per frame wakes the loop on the next
+// vertical blank of the CRTC showing the window; the MSC (vblank counter)
+// of each completion tells how many refreshes went by without a frame.
+#ifndef VSYNC_H
+#define VSYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xcb/xcb.h>
+#include <xcb/present.h>
+
+typedef struct {
+  bool present;          // Present >= 1.0 available
+  uint8_t opcode;        // major opcode; Present events arrive as XGE events
+  xcb_present_event_t eid;
+  xcb_window_t win;      // window whose CRTC paces the frames
+  bool pending;          // a NotifyMSC is outstanding
+  uint32_t serial;
+  uint64_t target_msc;   // vblank the outstanding request waits for; 0: any
+  uint64_t last_msc;     // vblank of the last completion; 0: none yet
+  uint64_t frames;       // completions received
+  uint64_t missed;       // vblanks that passed without a frame
+} vsync_t;
+
+// Checks for Present. The extension data must have been prefetched for this
+// to not block twice.
+bool vsync_init(vsync_t *v, xcb_connection_t *c);
+
+// Paces frames on win's CRTC (selects CompleteNotify on it); a no-op if win
+// is already the target.
+void vsync_target(vsync_t *v, xcb_connection_t *c, xcb_window_t win);
+
+// Asks for a wakeup on the vblank after the last one, unless a request is
+// already outstanding. Call after flushing a frame.
+void vsync_request(vsync_t *v, xcb_connection_t *c);
+
+// Forgets the last vblank, so the next request neither waits for a stale
+// target nor counts a deliberate pause (suspension) as missed frames.
+void vsync_reset(vsync_t *v);
+
+// Consumes Present events: returns true if ev was one, and sets *frame when
+// it completes the outstanding request (time to draw the next frame).
+bool vsync_handle_event(vsync_t *v, const xcb_generic_event_t *ev, bool *frame);
+
+#endif